@@ -0,0 +1,365 @@
+#include "sudoku_lib.hpp"
+#include "sudoku_service.hpp"
+#include <csignal>
+#include <fstream>
+#include <functional>
+#include <tuple>
+
+// Batch tool over streams of puzzles, one puzzle per line. Reads files or
+// stdin by batches, so memory is bounded, processes batch in threads and
+// writes results in the input order.
+class InputParser {
+public:
+  InputParser(int &argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+      tokens.push_back(std::string(argv[i]));
+    }
+  }
+  const std::string get(const std::string &option,
+                        const std::string &fallback = "") const {
+    auto itr = std::find(tokens.begin(), tokens.end(), option);
+    if (itr != tokens.end() && itr + 1 != tokens.end()) {
+      return *(itr + 1);
+    }
+    return fallback;
+  }
+
+  bool has(const std::string &option) const {
+    return std::find(tokens.begin(), tokens.end(), option) != tokens.end();
+  }
+
+  // arguments, that are not options or values of options
+  std::vector<std::string> positional(const std::vector<std::string> &with_values) const {
+    std::vector<std::string> res;
+    for (size_t i = 0; i < tokens.size(); i++) {
+      if (std::find(with_values.begin(), with_values.end(), tokens[i]) != with_values.end()) {
+        i++;
+      } else if (tokens[i].size() < 2 || tokens[i][0] != '-') {
+        res.push_back(tokens[i]);
+      }
+    }
+    return res;
+  }
+
+private:
+  std::vector<std::string> tokens;
+};
+
+void print_help() {
+  std::cerr
+      << "usage: sudoku_cli <command> [options] [files...]\n"
+      << "Reads puzzles (81 chars per line, '0' or '.' for empty cells) from\n"
+      << "files or stdin and writes one result per puzzle in the same order.\n"
+      << "Invalid puzzles give empty line (or empty record), lines shorter\n"
+      << "than 81 chars are also reported to stderr.\n\n"
+      << "commands:\n"
+      << "  solve         solution of the puzzle\n"
+      << "  count         number of solutions, not more than --limit\n"
+      << "  rate          HumanSolver score, is solved (0/1) and used methods\n"
+      << "  generate      --count new puzzles, no input\n"
+      << "  minimize      puzzle without unnecessary clues\n"
+      << "  canonicalize  minlex form of the puzzle\n"
+      << "  serve         run puzzle service on --socket until SIGINT or SIGTERM\n\n"
+      << "options:\n"
+      << "  -j N          number of threads (default: number of cores)\n"
+      << "  -o FILE       output file (default: stdout)\n"
+      << "  --binary      write BinaryPuzzleFile, needs -o\n"
+      << "  --limit N     limit for count (default: 99)\n"
+      << "  --unique      rate with uniqueness methods (puzzles must be unique)\n"
+      << "  --count N     number of puzzles to generate (default: 1)\n"
+      << "  --seed N      seed of generated puzzles (default: random)\n"
+      << "  --shard N     shard of generated puzzles (default: 0), puzzle k of\n"
+      << "                shard s depends only on seed, s and k\n"
+      << "  --first K     number of the first generated puzzle (default: 0)\n"
+      << "  --symmetry S  symmetry of clues of generated puzzles: rotation_180,\n"
+      << "                diagonal, anti_diagonal, horizontal, vertical,\n"
+      << "                rotation_90 or dihedral, several are joined by ','\n"
+      << "  --batch N     puzzles per batch (default: 4096)\n"
+      << "  --socket PATH socket of the service\n"
+      << "  --rating-cache FILE\n"
+      << "                RatingCache file, shared by all rate requests of service\n"
+      << "  --pool N      generated puzzles, that service keeps ready (default: 64)\n";
+}
+
+struct Options {
+  std::string command;
+  size_t threads = 1;
+  size_t limit = 99;
+  bool is_unique = false;
+};
+
+// Result of the command for one puzzle: text line and record for binary output.
+struct Output {
+  std::string line;
+  Sudoku::BinaryPuzzleFile::Record record;
+};
+
+Output run(const Options &options, std::string_view input) {
+  Output output;
+  output.record.clues = std::string(81, '0');
+  output.record.solution = std::string(81, '0');
+  Sudoku::Puzzle puzzle;
+  if (!puzzle.load(input)) {
+    return output;
+  }
+  output.record.clues = puzzle.clues_as_string();
+  if (options.command == "solve") {
+    Sudoku::Puzzle solved;
+    if (Sudoku::TdokuLib(puzzle).solve(solved)) {
+      output.line = output.record.solution = solved.clues_as_string();
+    }
+  } else if (options.command == "count") {
+    output.line =
+        std::to_string(Sudoku::TdokuLib(puzzle).count_solutions(options.limit));
+  } else if (options.command == "rate") {
+    Sudoku::HumanSolver::Result res =
+        Sudoku::HumanSolver(puzzle, options.is_unique).solve();
+    output.line = std::to_string(res.score) + "\t" +
+                  std::to_string(res.is_solved) + "\t";
+    std::string separator = "";
+    for (const std::string &method : res.used_methods) {
+      output.line += separator + method;
+      separator = ",";
+    }
+    output.record.rating = {res.score, res.is_solved,
+                            Sudoku::HumanSolver::methods_to_mask(res.used_methods)};
+  } else if (options.command == "minimize") {
+    output.line = Sudoku::TdokuLib(puzzle).minimize();
+    std::replace(output.line.begin(), output.line.end(), '.', '0');
+    output.record.clues = output.line;
+  } else if (options.command == "canonicalize") {
+    output.line = output.record.clues = puzzle.canonical();
+  } else {
+    output.line = output.record.clues;
+  }
+  return output;
+}
+
+Sudoku::Service::Server *running_server = nullptr;
+
+void stop_server(int) { running_server->stop(); }
+
+int serve(const InputParser &args, size_t threads, size_t pool_size) {
+  Sudoku::RatingCache rating_cache;
+  Sudoku::Service::Server::Options options;
+  options.threads = threads;
+  options.pool_size = pool_size;
+  if (args.has("--rating-cache")) {
+    if (!rating_cache.open(args.get("--rating-cache"), true)) {
+      std::cerr << "can't open rating cache " << args.get("--rating-cache") << "\n";
+      return 1;
+    }
+    options.rating_cache = &rating_cache;
+  }
+  Sudoku::Service::Server server(options);
+  if (!server.listen(args.get("--socket"))) {
+    std::cerr << "can't listen on \"" << args.get("--socket") << "\"\n";
+    return 1;
+  }
+  running_server = &server;
+  std::signal(SIGINT, stop_server);
+  std::signal(SIGTERM, stop_server);
+  // library writes its progress to std::cout
+  std::cout.setstate(std::ios::failbit);
+  server.run();
+  return 0;
+}
+
+// value of numeric option or fallback, if there is no option. False if value
+// is not a non-negative number.
+bool get_number(const InputParser &args, const std::string &option,
+                uint64_t fallback, uint64_t &value) {
+  if (!args.has(option)) {
+    value = fallback;
+    return true;
+  }
+  std::string text = args.get(option);
+  try {
+    size_t end = 0;
+    value = std::stoull(text, &end);
+    return end == text.size() && text[0] != '-';
+  } catch (const std::logic_error &) {
+    return false;
+  }
+}
+
+// names of Sudoku::Symmetry flags, joined by ','
+bool parse_symmetry(const std::string &names, uint32_t &symmetry) {
+  const std::map<std::string, uint32_t> flags = {
+      {"rotation_180", Sudoku::rotation_180},
+      {"diagonal", Sudoku::diagonal},
+      {"anti_diagonal", Sudoku::anti_diagonal},
+      {"horizontal", Sudoku::horizontal},
+      {"vertical", Sudoku::vertical},
+      {"rotation_90", Sudoku::rotation_90},
+      {"dihedral", Sudoku::dihedral}};
+  std::stringstream in(names);
+  for (std::string name; std::getline(in, name, ',');) {
+    if (flags.count(name) == 0) {
+      return false;
+    }
+    symmetry |= flags.at(name);
+  }
+  return true;
+}
+
+// calls function(i) for every i < count in threads
+void parallel_for(size_t threads, size_t count,
+                  const std::function<void(size_t)> &function) {
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      function(i);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min(threads, count); i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+int main(int argc, char **argv) {
+  InputParser args(argc, argv);
+  std::vector<std::string> positional =
+      args.positional({"-j", "-o", "--limit", "--count", "--seed", "--batch",
+                       "--socket", "--rating-cache", "--pool", "--symmetry",
+                       "--shard", "--first"});
+  const std::vector<std::string> commands = {
+      "solve",    "count",        "rate", "generate",
+      "minimize", "canonicalize", "serve"};
+  if (args.has("--help") || args.has("-h") || positional.empty() ||
+      std::find(commands.begin(), commands.end(), positional[0]) ==
+          commands.end()) {
+    print_help();
+    return positional.empty() ? 0 : 1;
+  }
+
+  uint64_t threads = 0, limit = 0, batch_size = 0, count = 0, seed = 0,
+           shard = 0, first_index = 0, pool_size = 0;
+  const std::vector<std::tuple<std::string, uint64_t, uint64_t *>> numbers = {
+      {"-j", std::max(1u, std::thread::hardware_concurrency()), &threads},
+      {"--limit", 99, &limit},
+      {"--batch", 4096, &batch_size},
+      {"--count", 1, &count},
+      {"--seed", std::random_device{}(), &seed},
+      {"--shard", 0, &shard},
+      {"--first", 0, &first_index},
+      {"--pool", 64, &pool_size}};
+  for (const auto &[option, fallback, value] : numbers) {
+    if (!get_number(args, option, fallback, *value)) {
+      std::cerr << option << " needs a number, not \"" << args.get(option)
+                << "\"\n";
+      print_help();
+      return 1;
+    }
+  }
+  batch_size = std::max<uint64_t>(batch_size, 1);
+
+  Options options;
+  options.command = positional[0];
+  options.threads = threads;
+  options.limit = limit;
+  options.is_unique = args.has("--unique");
+  std::vector<std::string> files(positional.begin() + 1, positional.end());
+  if (options.command == "serve") {
+    return serve(args, options.threads, pool_size);
+  }
+
+  bool is_binary = args.has("--binary");
+  std::string output_path = args.get("-o");
+  if (is_binary && (output_path.empty() || options.command == "count")) {
+    std::cerr << "--binary needs -o and doesn't work with count\n";
+    return 1;
+  }
+  uint32_t flags =
+      options.command == "solve"  ? uint32_t(Sudoku::BinaryPuzzleFile::with_solution)
+      : options.command == "rate" ? uint32_t(Sudoku::BinaryPuzzleFile::with_rating)
+                                  : uint32_t(0);
+  Sudoku::BinaryPuzzleWriter binary;
+  std::ofstream text_file;
+  bool is_open = true;
+  if (is_binary) {
+    is_open = binary.open(output_path, flags);
+  } else if (!output_path.empty()) {
+    text_file.open(output_path, std::ios::binary | std::ios::trunc);
+    is_open = text_file.is_open();
+  }
+  if (!is_open) {
+    std::cerr << "can't open " << output_path << "\n";
+    return 1;
+  }
+  std::ostream text(output_path.empty() ? std::cout.rdbuf() : text_file.rdbuf());
+  // library writes its progress to std::cout
+  std::cout.setstate(std::ios::failbit);
+
+  std::vector<std::string> batch;
+  std::vector<Output> outputs;
+  bool is_written = true;
+  auto flush_batch = [&](const std::function<Output(size_t)> &make) {
+    outputs.assign(batch.size(), {});
+    parallel_for(options.threads, batch.size(),
+                 [&](size_t i) { outputs[i] = make(i); });
+    for (const Output &output : outputs) {
+      if (is_binary) {
+        is_written = binary.write(output.record) && is_written;
+      } else {
+        text << output.line << '\n';
+      }
+    }
+    batch.clear();
+  };
+
+  if (options.command == "generate") {
+    uint32_t symmetry = 0;
+    if (!parse_symmetry(args.get("--symmetry"), symmetry)) {
+      std::cerr << "unknown symmetry \"" << args.get("--symmetry") << "\"\n";
+      return 1;
+    }
+    for (size_t first = 0; first < count; first += batch_size) {
+      batch.resize(std::min(batch_size, count - first));
+      flush_batch([&](size_t i) {
+        Sudoku::Generator generator(seed, shard, first_index + first + i);
+        generator.set_symmetry(symmetry);
+        return run(options, generator.generate().clues_as_string());
+      });
+    }
+  } else {
+    auto read = [&](std::istream &in, const std::string &name) {
+      std::string line;
+      for (size_t number = 1; std::getline(in, line); number++) {
+        // short line gives empty result like other invalid puzzles, so
+        // results stay in the order of lines
+        if (line.size() < 81) {
+          std::cerr << name << ":" << number << ": line is shorter than 81 chars\n";
+        }
+        batch.push_back(line.substr(0, 81));
+        if (batch.size() == batch_size) {
+          flush_batch([&](size_t i) { return run(options, batch[i]); });
+        }
+      }
+      flush_batch([&](size_t i) { return run(options, batch[i]); });
+    };
+    if (files.empty()) {
+      read(std::cin, "stdin");
+    }
+    for (const std::string &file : files) {
+      std::ifstream in(file);
+      if (!in) {
+        std::cerr << "can't open " << file << "\n";
+        return 1;
+      }
+      read(in, file);
+    }
+  }
+  text.flush();
+  if (is_binary ? !binary.close() || !is_written : !text) {
+    std::cerr << "can't write " << (output_path.empty() ? "stdout" : output_path)
+              << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1,12 +1,30 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -15,6 +33,18 @@
 #include <numeric>
 #include <random>
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Tdoku {
 #include "tdoku/tdoku.h"
 };
@@ -69,6 +99,64 @@ public:
   }
   std::vector<int> get_positions() { return possible_pos; }
 };
+
+// finalizer of SplitMix64
+inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+// fast non-cryptographic hash
+inline uint64_t hash64(const void *data, size_t size, uint64_t seed = 0) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = mix64(seed ^ size);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    hash = mix64(hash ^ word);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, bytes + i, size - i);
+  return mix64(hash ^ tail);
+}
+
+// Counter-based random generator in the style of SplitMix64: value number n
+// is mix64 of key and n, so stream is a pure function of its seed, and split
+// streams (shards, puzzles of shard) share no state. Can be used with
+// distributions, shuffle below is the same with every standard library.
+class CounterRng {
+private:
+  uint64_t key, counter = 0;
+
+public:
+  using result_type = uint64_t;
+  explicit CounterRng(uint64_t seed = 0) : key{mix64(seed)} {}
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type(0); }
+  result_type operator()() {
+    return mix64(key + ++counter * 0x9e3779b97f4a7c15ull);
+  }
+  // independent stream number index
+  CounterRng split(uint64_t index) const {
+    return CounterRng(key ^ mix64(index + 0x9e3779b97f4a7c15ull));
+  }
+  // random number in [0, bound)
+  uint32_t below(uint32_t bound) {
+    return uint64_t(uint32_t((*this)() >> 32)) * bound >> 32;
+  }
+};
+
+// Fisher-Yates shuffle with CounterRng::below
+template <class Iterator>
+void shuffle(Iterator first, Iterator last, CounterRng &rng) {
+  for (size_t i = last - first; i > 1; i--) {
+    std::swap(first[i - 1], first[rng.below(i)]);
+  }
+}
 } // namespace Utility
 class Pos {
 public:
@@ -81,6 +169,9 @@ public:
     col = 0;
     row = 0;
   }
+  // index of cell in row-major order, [0-80]
+  int index() const { return row * 9 + col; }
+  static Pos from_index(int index) { return {index % 9, index / 9}; }
   friend std::ostream &operator<<(std::ostream &os, const Pos &pos) {
     os << "{" << pos.col << ", " << pos.row << "}";
     return os;
@@ -217,6 +308,657 @@ public:
   Pos operator[](int idx) { return *next(begin(), idx); }
 };
 
+// Set of cells in 81 bits. Cell index is Pos::index(). Bits [0-63] are stored
+// in lo and bits [64-80] in hi.
+class Bitboard {
+public:
+  uint64_t lo = 0, hi = 0;
+
+  constexpr Bitboard() {}
+  constexpr Bitboard(uint64_t lo, uint64_t hi) : lo{lo}, hi{hi} {}
+
+  static constexpr Bitboard cell(int index) {
+    return index < 64 ? Bitboard{uint64_t(1) << index, 0}
+                      : Bitboard{0, uint64_t(1) << (index - 64)};
+  }
+  static constexpr Bitboard all() {
+    return {~uint64_t(0), (uint64_t(1) << 17) - 1};
+  }
+
+  constexpr bool test(int index) const {
+    return index < 64 ? (lo >> index) & 1 : (hi >> (index - 64)) & 1;
+  }
+  constexpr void set(int index) { *this = *this | cell(index); }
+  constexpr void reset(int index) { *this = and_not(cell(index)); }
+
+  int count() const {
+    return __builtin_popcountll(lo) + __builtin_popcountll(hi);
+  }
+  constexpr bool empty() const { return (lo | hi) == 0; }
+  // index of the lowest cell. Bitboard must not be empty
+  int first() const {
+    return lo != 0 ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(hi);
+  }
+
+  template <class Function> void for_each(Function function) const {
+    for (uint64_t bits = lo; bits != 0; bits &= bits - 1) {
+      function(__builtin_ctzll(bits));
+    }
+    for (uint64_t bits = hi; bits != 0; bits &= bits - 1) {
+      function(64 + __builtin_ctzll(bits));
+    }
+  }
+
+  constexpr Bitboard and_not(Bitboard other) const {
+    return {lo & ~other.lo, hi & ~other.hi};
+  }
+  constexpr Bitboard operator&(Bitboard other) const {
+    return {lo & other.lo, hi & other.hi};
+  }
+  constexpr Bitboard operator|(Bitboard other) const {
+    return {lo | other.lo, hi | other.hi};
+  }
+  constexpr Bitboard operator^(Bitboard other) const {
+    return {lo ^ other.lo, hi ^ other.hi};
+  }
+  constexpr Bitboard operator~() const { return all().and_not(*this); }
+  Bitboard &operator&=(Bitboard other) { return *this = *this & other; }
+  Bitboard &operator|=(Bitboard other) { return *this = *this | other; }
+  constexpr bool operator==(Bitboard other) const {
+    return lo == other.lo && hi == other.hi;
+  }
+  constexpr bool operator!=(Bitboard other) const { return !(*this == other); }
+
+  Figure to_figure() const {
+    Figure res;
+    for_each([&res](int index) { res.insert(Pos::from_index(index)); });
+    return res;
+  }
+};
+
+// Precomputed masks of houses and peers. Houses are numbered like in
+// HumanSolver: [0-8] - cols, [9-17] - rows, [18-26] - squares.
+namespace Tables {
+constexpr Bitboard col_mask(int number) {
+  Bitboard res;
+  for (int row = 0; row < 9; row++) {
+    res.set(row * 9 + number);
+  }
+  return res;
+}
+constexpr Bitboard row_mask(int number) {
+  Bitboard res;
+  for (int col = 0; col < 9; col++) {
+    res.set(number * 9 + col);
+  }
+  return res;
+}
+constexpr Bitboard square_mask(int number) {
+  Bitboard res;
+  for (int i = 0; i < 9; i++) {
+    res.set(((number / 3) * 3 + i / 3) * 9 + (number % 3) * 3 + i % 3);
+  }
+  return res;
+}
+constexpr std::array<Bitboard, 27> make_houses() {
+  std::array<Bitboard, 27> res{};
+  for (int i = 0; i < 9; i++) {
+    res[i] = col_mask(i);
+    res[9 + i] = row_mask(i);
+    res[18 + i] = square_mask(i);
+  }
+  return res;
+}
+constexpr std::array<Bitboard, 27> houses = make_houses();
+
+constexpr int square_of(int index) {
+  return (index / 27) * 3 + (index % 9) / 3;
+}
+// houses this cell belongs to: col, row and square
+constexpr std::array<int, 3> houses_of(int index) {
+  return {index % 9, 9 + index / 9, 18 + square_of(index)};
+}
+constexpr std::array<std::array<uint8_t, 3>, 81> make_cell_houses() {
+  std::array<std::array<uint8_t, 3>, 81> res{};
+  for (int index = 0; index < 81; index++) {
+    std::array<int, 3> of = houses_of(index);
+    res[index] = {uint8_t(of[0]), uint8_t(of[1]), uint8_t(of[2])};
+  }
+  return res;
+}
+// houses_of every cell, for loops over cells
+constexpr std::array<std::array<uint8_t, 3>, 81> cell_houses = make_cell_houses();
+
+constexpr std::array<Bitboard, 81> make_peers() {
+  std::array<Bitboard, 81> res{};
+  for (int index = 0; index < 81; index++) {
+    res[index] = (col_mask(index % 9) | row_mask(index / 9) |
+                  square_mask(square_of(index)))
+                     .and_not(Bitboard::cell(index));
+  }
+  return res;
+}
+// cells, that see the cell (not including cell itself)
+constexpr std::array<Bitboard, 81> peers = make_peers();
+
+// Rectangles, which corners lie in exactly two squares. Corners are ordered
+// as {row1, col1}, {row1, col2}, {row2, col1}, {row2, col2}.
+constexpr std::array<std::array<uint8_t, 4>, 486> make_rectangles() {
+  std::array<std::array<uint8_t, 4>, 486> res{};
+  int count = 0;
+  for (int row1 = 0; row1 < 9; row1++) {
+    for (int row2 = row1 + 1; row2 < 9; row2++) {
+      for (int col1 = 0; col1 < 9; col1++) {
+        for (int col2 = col1 + 1; col2 < 9; col2++) {
+          bool same_band = row1 / 3 == row2 / 3;
+          bool same_stack = col1 / 3 == col2 / 3;
+          if (same_band == same_stack) {
+            continue;
+          }
+          res[count++] = {uint8_t(row1 * 9 + col1), uint8_t(row1 * 9 + col2),
+                          uint8_t(row2 * 9 + col1), uint8_t(row2 * 9 + col2)};
+        }
+      }
+    }
+  }
+  return res;
+}
+constexpr std::array<std::array<uint8_t, 4>, 486> rectangles =
+    make_rectangles();
+
+// cells, which row is in rows and col is in cols. Bit i of rows (cols) is set
+// if row (col) i is included.
+constexpr Bitboard cross_mask(int rows, int cols) {
+  Bitboard res;
+  for (int index = 0; index < 81; index++) {
+    if ((rows >> (index / 9)) & (cols >> (index % 9)) & 1) {
+      res.set(index);
+    }
+  }
+  return res;
+}
+
+// Pair of cell sets, that contain the same digits the same number of times in
+// every solved puzzle. New equivalence can be added just by adding it to
+// set_equivalences.
+struct SetEquivalence {
+  const char *name;
+  Bitboard first, second;
+};
+constexpr std::array<SetEquivalence, 3> set_equivalences = {{
+    // 16 cells around central square and 2x2 corners of the grid
+    {"phistomefel ring", cross_mask(0b001111100, 0b001111100)
+                                 .and_not(cross_mask(0b000111000, 0b000111000)),
+     cross_mask(0b110000011, 0b110000011)},
+    // rows 1, 2, 8, 9 and corner squares without their common cells
+    {"rows and corner squares", cross_mask(0b110000011, 0b000111000),
+     cross_mask(0b001000100, 0b111000111)},
+    {"cols and corner squares", cross_mask(0b000111000, 0b110000011),
+     cross_mask(0b111000111, 0b001000100)},
+}};
+} // namespace Tables
+
+// Minlex canonical form of the puzzle: lexicographically smallest string among
+// all equivalent puzzles. Equivalent puzzles are made by transposition,
+// permutations of bands, stacks, rows inside bands, cols inside stacks and by
+// relabeling digits. Empty cells are '0', so they go first.
+//
+// Output is built row by row. Every row keeps only transformations, which give
+// the smallest row so far. Cols and stacks, that are equal in all placed rows,
+// stay tied: they are ordered only when a row tells them apart, so empty cols
+// don't multiply the transformations. Empty rows and bands are interchangeable,
+// so only one order of them is tried. The first row of a full grid is
+// 123456789 for any order of cols, so there the first two rows are placed
+// together and the second row chooses the order of cols.
+class Canonicalizer {
+private:
+  struct State {
+    uint8_t transposed = 0;
+    // source rows, that are already placed
+    uint16_t used = 0;
+    // source band of the current output band
+    uint8_t band = 0;
+    uint8_t next_label = 1;
+    std::array<uint8_t, 10> labels{};
+    // source col of each output col
+    std::array<uint8_t, 9> cols{{0, 1, 2, 3, 4, 5, 6, 7, 8}};
+    // Bit col is set if output cols col and col + 1 of the same stack are
+    // tied, bit 9 + stack if stacks stack and stack + 1 are tied.
+    uint16_t ties = 0x6db;
+  };
+
+  // Cols of the first two rows of a full grid, placed in the output so far
+  struct Placement {
+    // source col of output col or 9 if it is free
+    std::array<uint8_t, 9> cols{{9, 9, 9, 9, 9, 9, 9, 9, 9}};
+    // output col of source col or 9 if it is not placed
+    std::array<uint8_t, 9> positions{{9, 9, 9, 9, 9, 9, 9, 9, 9}};
+    // source stack of output stack and back, 3 if it is not chosen
+    std::array<uint8_t, 3> stacks{{3, 3, 3}};
+    std::array<uint8_t, 3> stack_positions{{3, 3, 3}};
+
+    void place(int col, int position) {
+      cols[position] = col;
+      positions[col] = position;
+      stacks[position / 3] = col / 3;
+      stack_positions[col / 3] = position / 3;
+    }
+    // the first free output col, where source col can go
+    int first_free(int col) const {
+      for (int position = 0; position < 9; position++) {
+        int stack = stacks[position / 3];
+        if (cols[position] == 9 &&
+            (stack == col / 3 || (stack == 3 && stack_positions[col / 3] == 3))) {
+          return position;
+        }
+      }
+      return 9;
+    }
+  };
+
+  std::array<std::array<uint8_t, 81>, 2> grids;
+  // bit i is set if row i of grid has no clues
+  std::array<uint16_t, 2> empty_rows;
+  std::vector<State> states, next_states;
+  std::array<uint8_t, 9> best, row;
+  std::array<uint8_t, 81> res;
+  // source col of each digit in the first row of a full grid
+  std::array<uint8_t, 10> digit_cols;
+
+  // true if there is unused empty row in the same band before source_row
+  bool is_repeated_row(const State &state, int source_row) const {
+    uint16_t empty = empty_rows[state.transposed] & ~state.used;
+    int first_in_band = source_row / 3 * 3;
+    return (empty & (1 << source_row)) &&
+           (empty & ((1 << source_row) - (1 << first_in_band)));
+  }
+  // true if there is unused empty band before band of source_row
+  bool is_repeated_band(const State &state, int source_row) const {
+    uint16_t empty = empty_rows[state.transposed] & ~state.used;
+    int band = source_row / 3;
+    for (int other = 0; other < band; other++) {
+      if (((empty >> (other * 3)) & 7) == 7 && ((empty >> (band * 3)) & 7) == 7) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void push_state(int cmp, const State &state) {
+    if (cmp > 0) {
+      return;
+    }
+    if (cmp < 0) {
+      next_states.clear();
+    }
+    next_states.push_back(state);
+  }
+
+  // true if first end cells of row are greater than the same cells of best
+  bool is_worse(int end) const {
+    return std::lexicographical_compare(best.begin(), best.begin() + end,
+                                        row.begin(), row.begin() + end);
+  }
+
+  // Places source row as output row stack by stack. Tied stacks are tried in
+  // every order, tied cols of a stack go in the order of their labels with
+  // empty cells first. Only digits without labels can go in any order, each
+  // order gives other labels. Drops the branch as soon as its prefix is
+  // greater than the best row.
+  void place_row(const State &state, const uint8_t *cells, int stack) {
+    if (stack == 3) {
+      State next = state;
+      for (int position = 0; position < 2; position++) {
+        // stacks stay tied only if the row is empty in both of them
+        if (row[position * 3] | row[position * 3 + 1] | row[position * 3 + 2] |
+            row[position * 3 + 3] | row[position * 3 + 4] |
+            row[position * 3 + 5]) {
+          next.ties &= ~(1 << (9 + position));
+        }
+      }
+      int cmp = best == row ? 0 : -1;
+      if (cmp < 0) {
+        best = row;
+      }
+      push_state(cmp, next);
+      return;
+    }
+    int last = stack;
+    while (last < 2 && (state.ties & (1 << (9 + last)))) {
+      last++;
+    }
+    bool tried_empty = false;
+    for (int other = stack; other <= last; other++) {
+      const uint8_t *cols = &state.cols[other * 3];
+      if (!(cells[cols[0]] | cells[cols[1]] | cells[cols[2]])) {
+        if (tried_empty) {
+          continue;
+        }
+        tried_empty = true;
+      }
+      State sorted = state;
+      uint8_t *sorted_cols = &sorted.cols[stack * 3];
+      for (int j = 0; j < 3; j++) {
+        std::swap(sorted_cols[j], sorted.cols[other * 3 + j]);
+      }
+      auto key = [&](int col) {
+        int digit = cells[col];
+        return digit == 0 ? 0 : sorted.labels[digit] ? sorted.labels[digit] : 10;
+      };
+      int tie_bits = (state.ties >> (stack * 3)) & 3;
+      for (int j = 1; j < 3; j++) {
+        for (int k = j; k > 0 && (tie_bits & (1 << (k - 1))) &&
+                        key(sorted_cols[k]) < key(sorted_cols[k - 1]);
+             k--) {
+          std::swap(sorted_cols[k], sorted_cols[k - 1]);
+        }
+      }
+      // tied digits without labels are the last in their group and are tried
+      // in every order, only the group of the first two cols ends before col 2
+      int new_end = tie_bits == 1 ? 2 : 3, new_begin = new_end;
+      while (new_begin > 0 && key(sorted_cols[new_begin - 1]) == 10 &&
+             (new_begin == new_end || (tie_bits & (1 << (new_begin - 1))))) {
+        new_begin--;
+      }
+      std::sort(sorted_cols + new_begin, sorted_cols + new_end);
+      do {
+        State next = sorted;
+        for (int j = 0; j < 3; j++) {
+          int digit = cells[next.cols[stack * 3 + j]];
+          if (digit != 0 && next.labels[digit] == 0) {
+            next.labels[digit] = next.next_label++;
+          }
+          row[stack * 3 + j] = next.labels[digit];
+        }
+        for (int j = 0; j < 2; j++) {
+          if (row[stack * 3 + j] | row[stack * 3 + j + 1]) {
+            next.ties &= ~(1 << (stack * 3 + j));
+          }
+        }
+        if (!is_worse(stack * 3 + 3)) {
+          place_row(next, cells, stack + 1);
+        }
+      } while (
+          std::next_permutation(sorted_cols + new_begin, sorted_cols + new_end));
+    }
+  }
+
+  // Clues of the row, placed as far right as permutation of cols allows. Bit 8
+  // is the first col. Rows with the smallest shape start the canonical form.
+  int row_shape(int transposed, int source_row) const {
+    std::array<int, 3> counts{};
+    for (int col = 0; col < 9; col++) {
+      counts[col / 3] += grids[transposed][source_row * 9 + col] != 0;
+    }
+    std::sort(counts.begin(), counts.end());
+    int shape = 0;
+    for (int count : counts) {
+      shape = (shape << 3) | ((1 << count) - 1);
+    }
+    return shape;
+  }
+
+  // Places the second row of a full grid col by col. Label of a digit is the
+  // output col of the digit in the first row, so the second row is the order
+  // of cols relabeled by itself. The col of a label goes to the first free
+  // col, where it can go, any other col would give a greater row.
+  void place_second_row(const State &state, const uint8_t *first,
+                        const uint8_t *second, const Placement &placement,
+                        int position) {
+    if (position == 9) {
+      State next = state;
+      next.cols = placement.cols;
+      next.ties = 0;
+      next.next_label = 10;
+      for (int col = 0; col < 9; col++) {
+        next.labels[first[col]] = placement.positions[col] + 1;
+      }
+      int cmp = best == row ? 0 : -1;
+      if (cmp < 0) {
+        best = row;
+      }
+      push_state(cmp, next);
+      return;
+    }
+    int begin = 0, end = 9;
+    if (placement.cols[position] != 9) {
+      begin = placement.cols[position];
+      end = begin + 1;
+    } else if (placement.stacks[position / 3] != 3) {
+      begin = placement.stacks[position / 3] * 3;
+      end = begin + 3;
+    }
+    for (int col = begin; col < end; col++) {
+      if (placement.cols[position] != col &&
+          (placement.positions[col] != 9 ||
+           (placement.stacks[position / 3] == 3 &&
+            placement.stack_positions[col / 3] != 3))) {
+        continue;
+      }
+      Placement next = placement;
+      next.place(col, position);
+      int label_col = digit_cols[second[col]];
+      if (next.positions[label_col] == 9) {
+        next.place(label_col, next.first_free(label_col));
+      }
+      row[position] = next.positions[label_col] + 1;
+      if (!is_worse(position + 1)) {
+        place_second_row(state, first, second, next, position + 1);
+      }
+    }
+  }
+
+public:
+  // puzzle and result are 81 chars, empty cells in puzzle can be '0' or '.'
+  void minlex(const char *puzzle, char *result) {
+    empty_rows = {0x1ff, 0x1ff};
+    int clues = 0;
+    for (int index = 0; index < 81; index++) {
+      char c = puzzle[index];
+      uint8_t digit = (c >= '1' && c <= '9') ? c - '0' : 0;
+      grids[0][index] = digit;
+      grids[1][(index % 9) * 9 + index / 9] = digit;
+      if (digit != 0) {
+        empty_rows[0] &= ~(1 << (index / 9));
+        empty_rows[1] &= ~(1 << (index % 9));
+        clues++;
+      }
+    }
+
+    int depth = 0;
+    best.fill(10);
+    next_states.clear();
+    if (clues == 81) {
+      // first row chooses transposition and source row, second row chooses
+      // the other source row and permutation of cols
+      for (int transposed = 0; transposed < 2; transposed++) {
+        for (int first = 0; first < 9; first++) {
+          const uint8_t *cells = &grids[transposed][first * 9];
+          for (int col = 0; col < 9; col++) {
+            digit_cols[cells[col]] = col;
+          }
+          for (int second = first / 3 * 3; second < first / 3 * 3 + 3;
+               second++) {
+            if (second == first) {
+              continue;
+            }
+            State state;
+            state.transposed = transposed;
+            state.used = (1 << first) | (1 << second);
+            state.band = first / 3;
+            place_second_row(state, cells, &grids[transposed][second * 9],
+                             Placement(), 0);
+          }
+        }
+      }
+      for (int col = 0; col < 9; col++) {
+        res[col] = col + 1;
+      }
+      std::copy(best.begin(), best.end(), res.begin() + 9);
+      depth = 2;
+    } else {
+      int best_shape = 0x1ff;
+      for (int transposed = 0; transposed < 2; transposed++) {
+        for (int source_row = 0; source_row < 9; source_row++) {
+          best_shape = std::min(best_shape, row_shape(transposed, source_row));
+        }
+      }
+      // first row chooses transposition, source row and permutation of cols
+      for (int transposed = 0; transposed < 2; transposed++) {
+        for (int source_row = 0; source_row < 9; source_row++) {
+          State state;
+          state.transposed = transposed;
+          if (row_shape(transposed, source_row) != best_shape ||
+              is_repeated_row(state, source_row) ||
+              is_repeated_band(state, source_row)) {
+            continue;
+          }
+          state.used = 1 << source_row;
+          state.band = source_row / 3;
+          place_row(state, &grids[transposed][source_row * 9], 0);
+        }
+      }
+      std::copy(best.begin(), best.end(), res.begin());
+      depth = 1;
+    }
+    states.swap(next_states);
+
+    for (; depth < 9; depth++) {
+      best.fill(10);
+      next_states.clear();
+      for (const State &state : states) {
+        for (int source_row = 0; source_row < 9; source_row++) {
+          if (state.used & (1 << source_row)) {
+            continue;
+          }
+          if (depth % 3 == 0
+                  ? (state.used & (7 << (source_row / 3 * 3))) != 0 ||
+                        is_repeated_band(state, source_row)
+                  : source_row / 3 != state.band) {
+            continue;
+          }
+          if (is_repeated_row(state, source_row)) {
+            continue;
+          }
+          State next = state;
+          next.used |= 1 << source_row;
+          next.band = source_row / 3;
+          place_row(next, &grids[state.transposed][source_row * 9], 0);
+        }
+      }
+      std::copy(best.begin(), best.end(), res.begin() + depth * 9);
+      states.swap(next_states);
+    }
+
+    for (int index = 0; index < 81; index++) {
+      result[index] = '0' + res[index];
+    }
+  }
+  // false if puzzle is not 81 chars, then result is not changed
+  bool minlex(const std::string &puzzle, std::string &result) {
+    if (puzzle.size() != 81) {
+      return false;
+    }
+    result.resize(81);
+    minlex(puzzle.data(), &result[0]);
+    return true;
+  }
+  // puzzles and results are count records of 81 chars one after another
+  void minlex(const char *puzzles, size_t count, char *results) {
+    for (size_t i = 0; i < count; i++) {
+      minlex(puzzles + i * 81, results + i * 81);
+    }
+  }
+  // false if some puzzle is not 81 chars, its result is empty then
+  bool minlex(const std::vector<std::string> &puzzles,
+              std::vector<std::string> &results) {
+    bool is_ok = true;
+    results.assign(puzzles.size(), std::string());
+    for (size_t i = 0; i < puzzles.size(); i++) {
+      is_ok &= minlex(puzzles[i], results[i]);
+    }
+    return is_ok;
+  }
+};
+
+// Result of PuzzleParser::parse. index is the first wrong char or the first
+// cell, which digit is already in its house.
+struct ParseResult {
+  enum Error { ok, wrong_size, wrong_char, repeated_digit };
+  Error error = ok;
+  int index = -1;
+  explicit operator bool() const { return error == ok; }
+};
+
+// Parser of puzzles: 81 chars, '1'-'9' for clues, '0' or '.' for empty
+// cells. Chars are classified by SSE2 compares, repeated digits are found by
+// bit masks of houses. Never prints.
+namespace PuzzleParser {
+// clues are 0 for empty cells, candidates are digits (bit digit - 1), that
+// are not in houses of empty cell, 0 for clues
+inline ParseResult parse(std::string_view from, std::array<uint8_t, 81> &clues,
+                         std::array<uint16_t, 81> &candidates) {
+  if (from.size() != 81) {
+    return {ParseResult::wrong_size, -1};
+  }
+  // chars, that are not digits or '.'
+  Bitboard wrong;
+  int index = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9),
+                dot = _mm_set1_epi8('.');
+  for (; index < 80; index += 16) {
+    __m128i chars =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(from.data() + index));
+    __m128i digits = _mm_sub_epi8(chars, zero);
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(clues.data() + index),
+                     _mm_and_si128(digits, is_digit));
+    uint64_t bad = ~_mm_movemask_epi8(_mm_or_si128(
+                       is_digit, _mm_cmpeq_epi8(chars, dot))) & 0xffff;
+    wrong |= index < 64 ? Bitboard{bad << index, 0}
+                        : Bitboard{0, bad << (index - 64)};
+  }
+#endif
+  for (; index < 81; index++) {
+    uint8_t digit = uint8_t(from[index] - '0');
+    clues[index] = digit <= 9 ? digit : 0;
+    if (digit > 9 && from[index] != '.') {
+      wrong.set(index);
+    }
+  }
+  if (!wrong.empty()) {
+    return {ParseResult::wrong_char, wrong.first()};
+  }
+
+  // no branches on empty cells, they are unpredictable: bit of empty cell is
+  // 0 and mask of its candidates is 0x1ff
+  std::array<uint16_t, 27> houses{};
+  int repeated = -1;
+  for (index = 0; index < 81; index++) {
+    uint16_t bit = uint16_t((1 << clues[index]) >> 1);
+    const std::array<uint8_t, 3> &of = Tables::cell_houses[index];
+    if (((houses[of[0]] | houses[of[1]] | houses[of[2]]) & bit) != 0 &&
+        repeated < 0) {
+      repeated = index;
+    }
+    houses[of[0]] |= bit;
+    houses[of[1]] |= bit;
+    houses[of[2]] |= bit;
+  }
+  for (index = 0; index < 81; index++) {
+    const std::array<uint8_t, 3> &of = Tables::cell_houses[index];
+    uint16_t empty = uint16_t((int(clues[index]) - 1) >> 8 & 0x1ff);
+    candidates[index] =
+        uint16_t(~(houses[of[0]] | houses[of[1]] | houses[of[2]]) & empty);
+  }
+  if (repeated >= 0) {
+    return {ParseResult::repeated_digit, repeated};
+  }
+  return {};
+}
+} // namespace PuzzleParser
+
 class Puzzle {
 private:
   std::map<Pos, int> clues;
@@ -247,29 +989,38 @@ private:
 public:
   Puzzle() { load(std::string(9 * 9, '0')); }
 
-  Puzzle(std::string puzzle) { load(puzzle); }
-  bool load(std::string from) {
-    if (from.size() != 9 * 9) {
-      std::cout << "Puzzle size (" << from.size() << ") != 9*9"
-                << "\nPuzzle: " << from << std::endl;
-      return false;
+  Puzzle(std::string_view puzzle) { load(puzzle); }
+  bool load(std::string_view from) { return bool(parse(from)); }
+  // Like load, but tells what is wrong. Puzzle is not changed if size or a
+  // char is wrong, clues are loaded if a digit is repeated.
+  ParseResult parse(std::string_view from) {
+    std::array<uint8_t, 81> digits;
+    std::array<uint16_t, 81> candidates;
+    ParseResult parsed = PuzzleParser::parse(from, digits, candidates);
+    if (parsed.error == ParseResult::wrong_size ||
+        parsed.error == ParseResult::wrong_char) {
+      return parsed;
     }
 
-    for (Pos pos : Figure(9, 9)) {
-			char c = from[pos.row * 9 + pos.col];
-			if (c == '.'){ 
-				c = '0';
-			}
-      clues[pos] = c - '0';
+    for (int index = 0; index < 81; index++) {
+      clues[Pos::from_index(index)] = digits[index];
     }
 
-    if (!is_right()) {
-      std::cout << "Puzzle is not right. Puzzle: " << from << std::endl;
-      return false;
+    if (parsed.error == ParseResult::repeated_digit) {
+      return parsed;
     }
 
-    generate_pencilmarks();
-    return true;
+    // the same pencilmarks as generate_pencilmarks gives
+    for (int index = 0; index < 81; index++) {
+      std::vector<int> &cell = pencilmarks[Pos::from_index(index)];
+      cell.clear();
+      for (int digit = 1; digit <= 9; digit++) {
+        if (candidates[index] & (1 << (digit - 1))) {
+          cell.push_back(digit);
+        }
+      }
+    }
+    return parsed;
   }
 
   void generate_pencilmarks() {
@@ -310,23 +1061,17 @@ public:
   }
 
   bool is_right() {
-    auto is_figure_right = [this](Figure figure) {
-      std::set<int> numbers;
-      for (Pos pos : figure) {
-        int number = clues[pos];
-        // if number is not inserted
-        if (number != 0 && !numbers.insert(number).second) {
+    std::array<uint16_t, 27> houses{};
+    for (std::pair<const Pos, int> &clue : clues) {
+      if (clue.second == 0) {
+        continue;
+      }
+      uint16_t bit = uint16_t(1 << (clue.second - 1));
+      for (int house : Tables::houses_of(clue.first.index())) {
+        if (houses[house] & bit) {
           return false;
         }
-      }
-      return true;
-    };
-    for (int i = 0; i < 9; i++) {
-      // if some of figures isn't right
-      if (!is_figure_right(Figure().col(i)) ||
-          !is_figure_right(Figure().row(i)) ||
-          !is_figure_right(Figure().square(i))) {
-        return false;
+        houses[house] |= bit;
       }
     }
     return true;
@@ -362,6 +1107,12 @@ public:
     }
   }
 
+  // sets clue and pencilmarks of the cell as they are, peers are not changed
+  void set_cell(Pos pos, int clue, std::vector<int> cell_pencilmarks) {
+    clues[pos] = clue;
+    pencilmarks[pos] = std::move(cell_pencilmarks);
+  }
+
   std::map<Pos, std::vector<int>> get_pencilmarks() { return pencilmarks; }
   std::map<Pos, std::vector<int>> get_pencilmarks(Figure &figure) {
     std::map<Pos, std::vector<int>> res;
@@ -470,677 +1221,4480 @@ public:
 		}
 		return res;
 	}
+
+  // minlex form of the clues, the same for all equivalent puzzles
+  std::string canonical() {
+    static thread_local Canonicalizer canonicalizer;
+    std::string clues = clues_as_string();
+    canonicalizer.minlex(clues, clues);
+    return clues;
+  }
+  uint64_t canonical_hash() {
+    std::string canonical_clues = canonical();
+    return Utility::hash64(canonical_clues.data(), canonical_clues.size());
+  }
 };
 
-class HumanSolver {
-private:
-  Puzzle puzzle;
-  std::map<std::string, int> method_scores_subsequent;
-  std::multimap<int, std::string> methods_score;
+// Text file with one puzzle per line, mapped into memory. Records are views
+// of the first 81 chars of every line (blanks can be '0' or '.'), so nothing
+// is copied until Puzzle::load. Shorter lines are skipped. File can be split
+// into chunks for worker threads, every chunk has whole lines only.
+class PuzzleFile {
+public:
+  class Chunk {
+  private:
+    const char *current, *end;
 
-  bool single_candidate_spot() {
-    std::map<Pos, std::vector<int>> pencilmarks = puzzle.get_pencilmarks();
-    for (Pos pos : Figure(9, 9)) {
-      if (pencilmarks[pos].size() != 1) {
-        continue;
+  public:
+    Chunk(const char *begin, const char *end) : current{begin}, end{end} {}
+    // returns false when chunk is over
+    bool next(std::string_view &record) {
+      while (current < end) {
+        const char *line_end = static_cast<const char *>(
+            std::memchr(current, '\n', end - current));
+        if (line_end == nullptr) {
+          line_end = end;
+        }
+        const char *line = current;
+        current = line_end + 1;
+        if (line_end - line >= 81) {
+          record = std::string_view(line, 81);
+          return true;
+        }
       }
-      puzzle.set_clue(pos, pencilmarks[pos][0]);
-      std::cout << "single candidate (" << pencilmarks[pos][0]
-                << ") spotted at: " << pos << std::endl;
-      return true;
+      return false;
     }
-    return false;
-  }
-  bool single_position_spot() {
-    std::map<Pos, std::vector<int>> pencilmarks = puzzle.get_pencilmarks();
-    auto find_single_position = [this, &pencilmarks](Figure figure) -> bool {
-      std::vector<int> single_position_pencilmarks =
-          puzzle.pencilmarks_with_count(figure, 1, 1);
-      if (single_position_pencilmarks.size() == 0) {
-        return false;
+    template <class Function> void for_each(Function function) {
+      std::string_view record;
+      while (next(record)) {
+        function(record);
       }
-      // get position of this pencilmark
-      Figure pencilmark_pos = puzzle.get_pencilmark_positions(
-          figure, single_position_pencilmarks[0]);
-      puzzle.set_clue(pencilmark_pos[0], single_position_pencilmarks[0]);
-      std::cout << "single position (" << single_position_pencilmarks[0]
-                << ") spotted at: " << pencilmark_pos[0] << std::endl;
-      return true;
-    };
-    for (int number = 0; number < 9; number++) {
+    }
+  };
 
-      Figure col = Figure().col(number);
-      Figure row = Figure().row(number);
-      Figure square = Figure().square(number);
+private:
+  int fd = -1;
+  const char *data = nullptr;
+  size_t size = 0;
 
-      if (find_single_position(square) || find_single_position(col) ||
-          find_single_position(row)) {
-        return true;
-      }
+  // start of the first line at or after position
+  size_t next_line_start(size_t position) const {
+    while (position > 0 && position < size && data[position - 1] != '\n') {
+      position++;
     }
-    return false;
+    return std::min(position, size);
   }
-  bool candidate_lines_spot() {
-    for (int square_number = 0; square_number < 9; square_number++) {
-      // counting all numbers in square pencilmarks
-      Figure square = Figure().square(square_number);
-      // finding numbers, which count in square equals to 2
-      std::vector<int> clues_count =
-          puzzle.pencilmarks_with_count(square, 2, 2);
-      for (int clue : clues_count) {
 
-        Figure numbers_position = puzzle.get_pencilmark_positions(square, clue);
+public:
+  PuzzleFile() = default;
+  PuzzleFile(const std::string &path) { open(path); }
+  PuzzleFile(const PuzzleFile &) = delete;
+  PuzzleFile &operator=(const PuzzleFile &) = delete;
+  ~PuzzleFile() { close(); }
 
-        Figure positions_to_blacklist;
-        if (numbers_position[0].col == numbers_position[1].col) {
-          positions_to_blacklist = Figure().col(numbers_position[0].col);
-        } else if (numbers_position[0].row == numbers_position[1].row) {
-          positions_to_blacklist = Figure().row(numbers_position[0].row);
+  bool open(const std::string &path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      close();
+      return false;
+    }
+    size = st.st_size;
+    if (size == 0) {
+      return true;
+    }
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close();
+      return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapped);
+    return true;
+  }
+  void close() {
+    if (data != nullptr) {
+      munmap(const_cast<char *>(data), size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+    data = nullptr;
+    size = 0;
+  }
+  bool is_open() const { return fd >= 0; }
+
+  // Chunk number index of count chunks of about the same size in bytes.
+  // Empty if index is out of range or count is 0.
+  Chunk chunk(size_t index, size_t count) const {
+    if (index >= count) {
+      return Chunk(data, data);
+    }
+    size_t begin = next_line_start(size / count * index);
+    size_t end = index + 1 == count ? size : next_line_start(size / count * (index + 1));
+    return Chunk(data + begin, data + end);
+  }
+  Chunk all() const { return chunk(0, 1); }
+  std::vector<Chunk> chunks(size_t count) const {
+    std::vector<Chunk> res;
+    for (size_t index = 0; index < count; index++) {
+      res.push_back(chunk(index, count));
+    }
+    return res;
+  }
+};
+
+// Pencilmarks and clues of the Puzzle as bit masks. Bit (digit - 1) of
+// candidates[index] is set if digit is pencilmarked in the cell.
+class CandidateGrid {
+public:
+  std::array<uint16_t, 81> candidates{};
+  std::array<uint8_t, 81> clues{};
+
+  CandidateGrid() {}
+  // clues and candidates of the puzzle string, see PuzzleParser
+  ParseResult parse(std::string_view from) {
+    return PuzzleParser::parse(from, clues, candidates);
+  }
+  CandidateGrid(Puzzle &puzzle) {
+    for (std::pair<Pos, int> clue : puzzle.get_clues()) {
+      clues[clue.first.index()] = clue.second;
+    }
+    for (auto pencilmarks : puzzle.get_pencilmarks()) {
+      for (int pencilmark : pencilmarks.second) {
+        if (pencilmark >= 1 && pencilmark <= 9) {
+          candidates[pencilmarks.first.index()] |= 1 << (pencilmark - 1);
         }
-        // if they aren't on the same row or col, skip this number
-        else {
+      }
+    }
+  }
+
+  // cells, which have digit pencilmarked
+  Bitboard plane(int digit) const {
+    Bitboard res;
+    for (int index = 0; index < 81; index++) {
+      if (candidates[index] & (1 << (digit - 1))) {
+        res.set(index);
+      }
+    }
+    return res;
+  }
+  // cells, which have digit as a clue
+  Bitboard clue_plane(int digit) const {
+    Bitboard res;
+    for (int index = 0; index < 81; index++) {
+      if (clues[index] == digit) {
+        res.set(index);
+      }
+    }
+    return res;
+  }
+
+  uint64_t hash() const {
+    return Utility::hash64(candidates.data(), sizeof(candidates),
+                           Utility::hash64(clues.data(), sizeof(clues)));
+  }
+
+  bool operator==(const CandidateGrid &other) const {
+    return candidates == other.candidates && clues == other.clues;
+  }
+  bool operator!=(const CandidateGrid &other) const {
+    return !(*this == other);
+  }
+};
+
+// Clues and pencilmarks of the game in 162 bytes: bits 0-8 of the cell are
+// its candidates, bits 12-15 are its clue (0 for empty cell). Trivially
+// copyable, so snapshots of sessions are plain copies.
+class GameState {
+public:
+  std::array<uint16_t, 81> cells{};
+
+  GameState() {}
+  explicit GameState(const CandidateGrid &grid) {
+    for (int index = 0; index < 81; index++) {
+      cells[index] = uint16_t(grid.clues[index] << 12 |
+                              (grid.clues[index] == 0 ? grid.candidates[index] : 0));
+    }
+  }
+  explicit GameState(Puzzle &puzzle) : GameState(CandidateGrid(puzzle)) {}
+
+  int clue(int index) const { return cells[index] >> 12; }
+  uint16_t candidates(int index) const { return cells[index] & 0x1ff; }
+
+  // removes digit from candidates of peers, like Puzzle::set_clue
+  void place(int index, int digit) {
+    cells[index] = uint16_t(digit << 12);
+    Tables::peers[index].for_each(
+        [&](int peer) { cells[peer] &= uint16_t(~(1 << (digit - 1))); });
+  }
+  void eliminate(int index, int digit) {
+    cells[index] &= uint16_t(~(1 << (digit - 1)));
+  }
+
+  CandidateGrid grid() const {
+    CandidateGrid res;
+    for (int index = 0; index < 81; index++) {
+      res.clues[index] = uint8_t(clue(index));
+      res.candidates[index] = candidates(index);
+    }
+    return res;
+  }
+  // pencilmarks of the puzzle are exactly the candidates of the state, even
+  // if clues of the state conflict
+  Puzzle puzzle() const {
+    Puzzle res;
+    for (int index = 0; index < 81; index++) {
+      std::vector<int> pencilmarks;
+      for (int digit = 1; digit <= 9; digit++) {
+        if (candidates(index) & (1 << (digit - 1))) {
+          pencilmarks.push_back(digit);
+        }
+      }
+      res.set_cell(Pos::from_index(index), clue(index), std::move(pencilmarks));
+    }
+    return res;
+  }
+
+  // Clues as 81 nibbles, then 9 bits of candidates for every empty cell:
+  // 41 to 133 bytes.
+  std::string serialize() const {
+    std::string res(41, '\0');
+    for (int index = 0; index < 81; index++) {
+      res[index / 2] |= char(clue(index) << (index % 2 * 4));
+    }
+    uint32_t bits = 0;
+    int count = 0;
+    for (int index = 0; index < 81; index++) {
+      if (clue(index) != 0) {
+        continue;
+      }
+      bits |= uint32_t(candidates(index)) << count;
+      for (count += 9; count >= 8; count -= 8, bits >>= 8) {
+        res.push_back(char(bits & 0xff));
+      }
+    }
+    if (count > 0) {
+      res.push_back(char(bits));
+    }
+    return res;
+  }
+  bool deserialize(std::string_view from) {
+    if (from.size() < 41) {
+      return false;
+    }
+    GameState state;
+    int empty = 0;
+    for (int index = 0; index < 81; index++) {
+      int digit = uint8_t(from[index / 2]) >> (index % 2 * 4) & 0xf;
+      if (digit > 9) {
+        return false;
+      }
+      state.cells[index] = uint16_t(digit << 12);
+      empty += digit == 0;
+    }
+    if (from.size() != 41 + size_t(empty * 9 + 7) / 8) {
+      return false;
+    }
+    size_t next = 41;
+    uint32_t bits = 0;
+    int count = 0;
+    for (int index = 0; index < 81; index++) {
+      if (state.cells[index] != 0) {
+        continue;
+      }
+      for (; count < 9; count += 8) {
+        bits |= uint32_t(uint8_t(from[next++])) << count;
+      }
+      state.cells[index] = uint16_t(bits & 0x1ff);
+      bits >>= 9;
+      count -= 9;
+    }
+    *this = state;
+    return true;
+  }
+
+  bool operator==(const GameState &other) const { return cells == other.cells; }
+  bool operator!=(const GameState &other) const { return !(*this == other); }
+};
+
+// Undo and redo of the game: snapshots of GameState in one vector, so push,
+// undo and redo are O(1) and don't allocate after the first pushes.
+class GameHistory {
+  std::vector<GameState> states;
+  size_t current = 0;
+
+public:
+  explicit GameHistory(const GameState &start) : states{start} {}
+
+  const GameState &state() const { return states[current]; }
+  // new state after the current one, states, that could be redone, are dropped
+  void push(const GameState &state) {
+    states.resize(++current);
+    states.push_back(state);
+  }
+  bool undo() {
+    if (current == 0) {
+      return false;
+    }
+    current--;
+    return true;
+  }
+  bool redo() {
+    if (current + 1 == states.size()) {
+      return false;
+    }
+    current++;
+    return true;
+  }
+  size_t size() const { return states.size(); }
+};
+
+// Live play of one puzzle. Cells of every digit are kept as Bitboards and
+// the solution is found once, so every check of a move is a few bit
+// operations. Cells, that conflict with peers, and wrong cells are updated
+// by every move.
+class GameSession {
+  std::array<uint8_t, 81> digits{};
+  // all zeros if puzzle has no solution
+  std::array<uint8_t, 81> solution{};
+  // cells of every digit
+  std::array<Bitboard, 9> planes{};
+  Bitboard givens, wrong, conflicting;
+  int filled = 0;
+
+  // cells, whose conflicts can change, when digit is placed or erased in cell
+  void update_conflicts(int index, int digit) {
+    Bitboard plane = planes[digit - 1];
+    ((plane & Tables::peers[index]) | Bitboard::cell(index)).for_each([&](int cell) {
+      if (digits[cell] == digit && !(plane & Tables::peers[cell]).empty()) {
+        conflicting.set(cell);
+      } else {
+        conflicting.reset(cell);
+      }
+    });
+  }
+  void set_digit(int index, int digit) {
+    int old = digits[index];
+    if (old == digit) {
+      return;
+    }
+    if (old != 0) {
+      digits[index] = 0;
+      planes[old - 1].reset(index);
+      filled--;
+      update_conflicts(index, old);
+    }
+    wrong.reset(index);
+    if (digit != 0) {
+      digits[index] = uint8_t(digit);
+      planes[digit - 1].set(index);
+      filled++;
+      update_conflicts(index, digit);
+      if (has_solution() && digit != solution[index] && !givens.test(index)) {
+        wrong.set(index);
+      }
+    }
+  }
+
+public:
+  GameSession() {}
+  GameSession(std::string_view clues) { load(clues); }
+  // clues as in Puzzle, returns false if they conflict
+  bool load(std::string_view clues) {
+    *this = GameSession();
+    CandidateGrid grid;
+    if (!grid.parse(clues)) {
+      return false;
+    }
+    char puzzle[82] = {};
+    for (int index = 0; index < 81; index++) {
+      puzzle[index] = grid.clues[index] == 0 ? '.' : char('0' + grid.clues[index]);
+      if (grid.clues[index] != 0) {
+        givens.set(index);
+        set_digit(index, grid.clues[index]);
+      }
+    }
+    char solved[81];
+    size_t number_of_guesses = 0;
+    if (Tdoku::SolveSudoku(puzzle, 1, 0, solved, &number_of_guesses) != 0) {
+      for (int index = 0; index < 81; index++) {
+        solution[index] = uint8_t(solved[index] - '0');
+      }
+    }
+    return true;
+  }
+
+  // digit 0 erases the cell, givens can't be changed
+  bool set(int index, int digit) {
+    if (givens.test(index) || digit < 0 || digit > 9) {
+      return false;
+    }
+    set_digit(index, digit);
+    return true;
+  }
+
+  int digit(int index) const { return digits[index]; }
+  bool is_given(int index) const { return givens.test(index); }
+  bool has_solution() const { return solution[0] != 0; }
+  // digit (1-9) is already in a peer of the cell
+  bool conflicts(int index, int digit) const {
+    return digit >= 1 && digit <= 9 &&
+           !(planes[digit - 1] & Tables::peers[index]).empty();
+  }
+  // false for digits out of 1-9 and if puzzle has no solution
+  bool matches_solution(int index, int digit) const {
+    return digit >= 1 && digit <= 9 && solution[index] == digit;
+  }
+  // cells, which digit is also in their peer
+  Bitboard conflicting_cells() const { return conflicting; }
+  // filled cells, that differ from the solution, empty without solution
+  Bitboard wrong_cells() const { return wrong; }
+  // all cells are filled and no digit repeats in a house
+  bool is_complete() const { return filled == 81 && conflicting.empty(); }
+};
+
+// Checks of complete solution grids (81 digits '1'-'9') in batches. With
+// SSSE3 digits of a row become bits by byte shuffles, so one grid is checked
+// by about a hundred vector operations, otherwise by bit masks of houses.
+namespace GridValidator {
+// every row, col and square has all digits
+inline bool is_valid_scalar(const char *grid) {
+  std::array<uint16_t, 27> masks{};
+  uint32_t bad = 0;
+  for (int index = 0; index < 81; index++) {
+    uint32_t digit = uint8_t(grid[index] - '1');
+    bad |= digit > 8;
+    uint16_t bit = uint16_t(1 << (digit & 15));
+    for (int house : Tables::houses_of(index)) {
+      masks[house] |= bit;
+    }
+  }
+  for (uint16_t mask : masks) {
+    bad |= mask != 0x1ff;
+  }
+  return bad == 0;
+}
+
+#if defined(__SSSE3__)
+// reads 7 bytes after the grid
+inline bool is_valid_ssse3(const char *grid) {
+  // digit - 1 to its bit: digits 1-8 to bits of lo, digit 9 to hi
+  const __m128i to_lo = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0,
+                                      0, 0, 0, 0);
+  const __m128i to_hi = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0,
+                                      0, 0, 0);
+  const __m128i row_lanes = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          0, 0, 0, 0, 0, 0, 0);
+  const __m128i one = _mm_set1_epi8('1'), eight = _mm_set1_epi8(8);
+  __m128i cols_lo = _mm_setzero_si128(), cols_hi = _mm_setzero_si128();
+  __m128i squares_lo = _mm_set1_epi8(-1), squares_hi = _mm_set1_epi8(-1);
+  __m128i bad = _mm_setzero_si128(), rows = _mm_setzero_si128();
+  for (int band = 0; band < 3; band++) {
+    __m128i band_lo = _mm_setzero_si128(), band_hi = _mm_setzero_si128();
+    for (int row = band * 3; row < band * 3 + 3; row++) {
+      __m128i digits = _mm_sub_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(grid + row * 9)), one);
+      // lanes after the row become 0xff, shuffles give 0 for them
+      digits = _mm_or_si128(digits, _mm_andnot_si128(row_lanes, _mm_set1_epi8(-1)));
+      bad = _mm_or_si128(bad, _mm_and_si128(row_lanes, _mm_xor_si128(
+          digits, _mm_min_epu8(digits, eight))));
+      __m128i lo = _mm_shuffle_epi8(to_lo, digits);
+      __m128i hi = _mm_shuffle_epi8(to_hi, digits);
+      band_lo = _mm_or_si128(band_lo, lo);
+      band_hi = _mm_or_si128(band_hi, hi);
+      // bits of lo are distinct if 8 of them sum to 255, and there is one 9
+      __m128i sums = _mm_add_epi64(
+          _mm_sad_epu8(lo, _mm_setzero_si128()),
+          _mm_slli_epi64(_mm_sad_epu8(hi, _mm_setzero_si128()), 16));
+      sums = _mm_add_epi64(sums, _mm_srli_si128(sums, 8));
+      rows = _mm_or_si128(rows, _mm_xor_si128(sums, _mm_cvtsi32_si128(0x100ff)));
+    }
+    cols_lo = _mm_or_si128(cols_lo, band_lo);
+    cols_hi = _mm_or_si128(cols_hi, band_hi);
+    // lanes 0, 3 and 6 become squares of the band
+    band_lo = _mm_or_si128(band_lo, _mm_or_si128(_mm_srli_si128(band_lo, 1),
+                                                 _mm_srli_si128(band_lo, 2)));
+    band_hi = _mm_or_si128(band_hi, _mm_or_si128(_mm_srli_si128(band_hi, 1),
+                                                 _mm_srli_si128(band_hi, 2)));
+    squares_lo = _mm_and_si128(squares_lo, band_lo);
+    squares_hi = _mm_and_si128(squares_hi, band_hi);
+  }
+  int cols = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(cols_lo, _mm_set1_epi8(-1)),
+      _mm_cmpeq_epi8(cols_hi, _mm_set1_epi8(1))));
+  int squares = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(squares_lo, _mm_set1_epi8(-1)),
+      _mm_cmpeq_epi8(squares_hi, _mm_set1_epi8(1))));
+  return (cols & 0x1ff) == 0x1ff && (squares & 0x49) == 0x49 &&
+         _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(bad, _mm_move_epi64(rows)),
+                                          _mm_setzero_si128())) == 0xffff;
+}
+#endif
+
+// is_padded, if at least 7 bytes after the grid can be read
+inline bool is_valid(const char *grid, bool is_padded = false) {
+#if defined(__SSSE3__)
+  if (!is_padded) {
+    char copy[96] = {};
+    memcpy(copy, grid, 81);
+    return is_valid_ssse3(copy);
+  }
+  return is_valid_ssse3(grid);
+#else
+  (void)is_padded;
+  return is_valid_scalar(grid);
+#endif
+}
+
+// Bit i of the result is set if grid i is not valid. Grids are stride bytes
+// apart.
+inline std::vector<uint64_t> validate(const char *grids, size_t count,
+                                      size_t stride = 81) {
+  std::vector<uint64_t> failures((count + 63) / 64);
+  for (size_t i = 0; i < count; i++) {
+    bool is_failed = !is_valid(grids + i * stride, i + 1 < count);
+    failures[i / 64] |= uint64_t(is_failed) << (i % 64);
+  }
+  return failures;
+}
+inline std::vector<uint64_t> validate(const std::vector<std::string> &grids) {
+  std::vector<uint64_t> failures((grids.size() + 63) / 64);
+  for (size_t i = 0; i < grids.size(); i++) {
+    bool is_failed = grids[i].size() != 81 || !is_valid(grids[i].data());
+    failures[i / 64] |= uint64_t(is_failed) << (i % 64);
+  }
+  return failures;
+}
+} // namespace GridValidator
+
+// Set of (cell, digit) pairs, stored as one Bitboard per digit.
+class LiteralSet {
+public:
+  std::array<Bitboard, 9> digits{};
+
+  bool test(int index, int digit) const {
+    return digits[digit - 1].test(index);
+  }
+  void set(int index, int digit) { digits[digit - 1].set(index); }
+  bool empty() const {
+    for (Bitboard digit : digits) {
+      if (!digit.empty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool intersects(const LiteralSet &other) const {
+    return !(*this & other).empty();
+  }
+  template <class Function> void for_each(Function function) const {
+    for (int digit = 1; digit <= 9; digit++) {
+      digits[digit - 1].for_each(
+          [&function, digit](int index) { function(index, digit); });
+    }
+  }
+
+  LiteralSet operator&(const LiteralSet &other) const {
+    LiteralSet res;
+    for (int i = 0; i < 9; i++) {
+      res.digits[i] = digits[i] & other.digits[i];
+    }
+    return res;
+  }
+  LiteralSet operator|(const LiteralSet &other) const {
+    LiteralSet res;
+    for (int i = 0; i < 9; i++) {
+      res.digits[i] = digits[i] | other.digits[i];
+    }
+    return res;
+  }
+  LiteralSet and_not(const LiteralSet &other) const {
+    LiteralSet res;
+    for (int i = 0; i < 9; i++) {
+      res.digits[i] = digits[i].and_not(other.digits[i]);
+    }
+    return res;
+  }
+};
+
+// Alternating inference chains over pencilmarks. Every pencilmark (literal)
+// can be "on" or "off". If literal is on, all literals weakly linked to it
+// (same cell or same digit in the peer cell) are off. If literal is off, all
+// literals strongly linked to it (the only other pencilmark in the cell, or
+// the only other position of the digit in the house) are on.
+//
+// Strong links are kept between calls and rebuilt only for houses, which
+// pencilmarks were changed. Implications of every literal are memoized and
+// dropped only when they touch a changed literal.
+class ForcingChains {
+public:
+  struct Limits {
+    // maximum number of links in one chain
+    int max_depth = 16;
+    // maximum number of literals visited during one find() call
+    int max_nodes = 200000;
+  };
+  class Chain {
+  public:
+    Pos start;
+    int digit = 0;
+    // true if chain starts with start being on
+    bool is_on = false;
+    std::vector<std::pair<Pos, int>> eliminations;
+  };
+
+private:
+  struct Implications {
+    bool valid = false;
+    LiteralSet on, off;
+  };
+
+  Limits limits;
+  bool has_graph = false;
+  CandidateGrid grid;
+  LiteralSet present;
+  std::array<std::array<int16_t, 4>, 729> strong{};
+  std::array<uint8_t, 729> strong_count{};
+  // [0] - implications of literal being off, [1] - being on
+  std::vector<Implications> memo[2];
+  int nodes_left = 0;
+
+  static int literal(int index, int digit) { return index * 9 + digit - 1; }
+
+  void build_strong(int index, int digit) {
+    int id = literal(index, digit);
+    std::array<int16_t, 4> links{};
+    uint8_t count = 0;
+    auto add = [&links, &count](int other) {
+      for (int i = 0; i < count; i++) {
+        if (links[i] == other) {
+          return;
+        }
+      }
+      links[count++] = other;
+    };
+    if (present.test(index, digit)) {
+      uint16_t cell = grid.candidates[index];
+      if (__builtin_popcount(cell) == 2) {
+        int other_digit = __builtin_ctz(cell & ~(1 << (digit - 1))) + 1;
+        add(literal(index, other_digit));
+      }
+      for (int house : Tables::houses_of(index)) {
+        Bitboard positions = Tables::houses[house] & present.digits[digit - 1];
+        if (positions.count() == 2) {
+          add(literal(positions.and_not(Bitboard::cell(index)).first(), digit));
+        }
+      }
+    }
+    strong[id] = links;
+    strong_count[id] = count;
+  }
+
+  void build_graph() {
+    present = {};
+    for (int index = 0; index < 81; index++) {
+      for (int digit = 1; digit <= 9; digit++) {
+        if (grid.candidates[index] & (1 << (digit - 1))) {
+          present.set(index, digit);
+        }
+      }
+    }
+    for (int index = 0; index < 81; index++) {
+      for (int digit = 1; digit <= 9; digit++) {
+        build_strong(index, digit);
+      }
+    }
+  }
+
+  void clear_memo() {
+    for (auto &implications : memo) {
+      implications.assign(729, {});
+    }
+  }
+
+  // literals, which are off if at least one of literals is on
+  LiteralSet weak(const LiteralSet &on) const {
+    LiteralSet res;
+    Bitboard prefix, suffix[10];
+    for (int i = 8; i >= 0; i--) {
+      suffix[i] = suffix[i + 1] | on.digits[i];
+    }
+    for (int i = 0; i < 9; i++) {
+      Bitboard off = prefix | suffix[i + 1];
+      on.digits[i].for_each(
+          [&off, this](int index) { off |= Tables::peers[index]; });
+      res.digits[i] = off & present.digits[i];
+      prefix |= on.digits[i];
+    }
+    return res;
+  }
+  // literals, which are on if at least one of literals is off
+  LiteralSet strong_of(const LiteralSet &off) const {
+    LiteralSet res;
+    off.for_each([&res, this](int index, int digit) {
+      int id = literal(index, digit);
+      for (int i = 0; i < strong_count[id]; i++) {
+        res.set(strong[id][i] / 9, strong[id][i] % 9 + 1);
+      }
+    });
+    return res;
+  }
+
+  // returns nullptr if node limit is reached
+  const Implications *implications(int index, int digit, bool is_on) {
+    Implications &res = memo[is_on][literal(index, digit)];
+    if (res.valid) {
+      return &res;
+    }
+    LiteralSet on, off, frontier_on, frontier_off;
+    if (is_on) {
+      on.set(index, digit);
+      frontier_on = on;
+    } else {
+      off.set(index, digit);
+      frontier_off = off;
+    }
+    for (int depth = 0; depth < limits.max_depth; depth++) {
+      LiteralSet new_off = weak(frontier_on).and_not(off);
+      LiteralSet new_on = strong_of(frontier_off).and_not(on);
+      if (new_off.empty() && new_on.empty()) {
+        break;
+      }
+      on = on | new_on;
+      off = off | new_off;
+      // contradiction, there is no need to go further
+      if (on.intersects(off)) {
+        break;
+      }
+      frontier_on = new_on;
+      frontier_off = new_off;
+      for (Bitboard digit_plane : new_on.digits) {
+        nodes_left -= digit_plane.count();
+      }
+      for (Bitboard digit_plane : new_off.digits) {
+        nodes_left -= digit_plane.count();
+      }
+      if (nodes_left < 0) {
+        return nullptr;
+      }
+    }
+    res.on = on;
+    res.off = off;
+    res.valid = true;
+    return &res;
+  }
+
+  Chain make_chain(int index, int digit, bool is_on,
+                   const LiteralSet &eliminations) {
+    Chain chain;
+    chain.start = Pos::from_index(index);
+    chain.digit = digit;
+    chain.is_on = is_on;
+    eliminations.for_each([&chain](int index, int digit) {
+      chain.eliminations.push_back({Pos::from_index(index), digit});
+    });
+    return chain;
+  }
+
+public:
+  void set_limits(Limits limits) {
+    this->limits = limits;
+    clear_memo();
+  }
+  Limits get_limits() { return limits; }
+
+  // Loads new pencilmarks. If pencilmarks were only removed since the last
+  // call, the graph is updated only around changed cells.
+  void update(const CandidateGrid &new_grid) {
+    if (memo[0].empty()) {
+      clear_memo();
+    }
+    bool only_removed = has_graph;
+    Bitboard changed;
+    for (int index = 0; index < 81 && only_removed; index++) {
+      if (new_grid.candidates[index] != grid.candidates[index]) {
+        if (new_grid.candidates[index] & ~grid.candidates[index]) {
+          only_removed = false;
+        }
+        changed.set(index);
+      }
+    }
+    if (!only_removed) {
+      grid = new_grid;
+      build_graph();
+      clear_memo();
+      has_graph = true;
+      return;
+    }
+    if (changed.empty()) {
+      return;
+    }
+
+    LiteralSet old_present = present;
+    grid = new_grid;
+    LiteralSet dirty;
+    changed.for_each([this](int index) {
+      for (int digit = 1; digit <= 9; digit++) {
+        if (!(grid.candidates[index] & (1 << (digit - 1)))) {
+          present.digits[digit - 1].reset(index);
+        }
+      }
+    });
+    dirty = old_present.and_not(present);
+
+    Bitboard houses_changed;
+    changed.for_each([&houses_changed](int index) {
+      houses_changed |= Tables::peers[index] | Bitboard::cell(index);
+    });
+    houses_changed.for_each([&dirty, this](int index) {
+      for (int digit = 1; digit <= 9; digit++) {
+        int id = literal(index, digit);
+        std::array<int16_t, 4> old_links = strong[id];
+        uint8_t old_count = strong_count[id];
+        build_strong(index, digit);
+        if (old_count != strong_count[id] || old_links != strong[id]) {
+          dirty.set(index, digit);
+        }
+      }
+    });
+
+    for (auto &implications : memo) {
+      for (int id = 0; id < 729; id++) {
+        Implications &imp = implications[id];
+        if (!imp.valid) {
           continue;
         }
-        // remove first and second number positions (they are guaranteed to be
-        // in blacklist)
-        positions_to_blacklist.remove(numbers_position);
+        if (imp.on.intersects(dirty) || imp.off.intersects(dirty) ||
+            dirty.test(id / 9, id % 9 + 1)) {
+          imp.valid = false;
+        }
+      }
+    }
+  }
+
+  // Searches for the chain, that removes at least one pencilmark. Returns
+  // false if there is no such chain or node limit is reached.
+  bool find(Chain &chain) {
+    nodes_left = limits.max_nodes;
+    for (int index = 0; index < 81; index++) {
+      for (int digit = 1; digit <= 9; digit++) {
+        if (!present.test(index, digit)) {
+          continue;
+        }
+        LiteralSet start;
+        start.set(index, digit);
+        LiteralSet weak_to_start = weak(start);
+
+        // if literal is off, then everything in off is off. Literals, that
+        // see start, are off in both cases.
+        const Implications *if_off = implications(index, digit, false);
+        if (if_off == nullptr) {
+          return false;
+        }
+        LiteralSet eliminations;
+        if (if_off->on.test(index, digit) || if_off->on.intersects(if_off->off)) {
+          eliminations = weak_to_start;
+        } else {
+          eliminations = weak_to_start & if_off->off;
+        }
+        if (!eliminations.empty()) {
+          chain = make_chain(index, digit, false, eliminations);
+          return true;
+        }
+
+        // if literal leads to contradiction, it is off
+        const Implications *if_on = implications(index, digit, true);
+        if (if_on == nullptr) {
+          return false;
+        }
+        if (if_on->on.intersects(if_on->off)) {
+          chain = make_chain(index, digit, true, start);
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+// Result of one HumanSolver step: method and what it changed in the puzzle.
+class SolvingStep {
+public:
+  // empty if no method can be applied
+  std::string method;
+  std::vector<std::pair<Pos, int>> placements;
+  std::vector<std::pair<Pos, int>> eliminations;
+
+  // difference between pencilmarks before and after the step
+  SolvingStep(std::string method, const CandidateGrid &before,
+              const CandidateGrid &after)
+      : method{method} {
+    for (int index = 0; index < 81; index++) {
+      Pos pos = Pos::from_index(index);
+      if (before.clues[index] != after.clues[index]) {
+        placements.push_back({pos, after.clues[index]});
+        continue;
+      }
+      uint16_t removed = before.candidates[index] & ~after.candidates[index];
+      for (int digit = 1; digit <= 9; digit++) {
+        if (removed & (1 << (digit - 1))) {
+          eliminations.push_back({pos, digit});
+        }
+      }
+    }
+  }
+  SolvingStep() {}
+
+  void apply(Puzzle &puzzle) const {
+    for (std::pair<Pos, int> placement : placements) {
+      puzzle.set_clue(placement.first, placement.second);
+    }
+    for (std::pair<Pos, int> elimination : eliminations) {
+      puzzle.remove_pencilmark_from_cell(elimination.first, elimination.second);
+    }
+  }
+};
+
+// Bounded cache of HumanSolver steps with CLOCK eviction. Key is the hash of
+// pencilmarks and of the state of HumanSolver. Can be shared between solvers
+// (and threads).
+class StepCache {
+public:
+  class Stats {
+  public:
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    double hit_rate() const {
+      return hits + misses == 0 ? 0 : double(hits) / double(hits + misses);
+    }
+  };
+
+private:
+  struct Entry {
+    uint64_t key = 0;
+    bool is_referenced = false;
+    SolvingStep step;
+  };
+  std::vector<Entry> entries;
+  std::unordered_map<uint64_t, size_t> index;
+  size_t capacity;
+  size_t hand = 0;
+  Stats stats;
+  std::mutex mutex;
+
+public:
+  StepCache(size_t capacity = 1 << 16) : capacity{std::max<size_t>(capacity, 1)} {
+    entries.reserve(this->capacity);
+    index.reserve(this->capacity);
+  }
+
+  bool find(uint64_t key, SolvingStep &step) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end()) {
+      stats.misses++;
+      return false;
+    }
+    stats.hits++;
+    entries[it->second].is_referenced = true;
+    step = entries[it->second].step;
+    return true;
+  }
+
+  void insert(uint64_t key, const SolvingStep &step) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index.count(key) != 0) {
+      return;
+    }
+    if (entries.size() < capacity) {
+      index[key] = entries.size();
+      entries.push_back({key, false, step});
+      return;
+    }
+    // give second chance to every referenced entry
+    while (entries[hand].is_referenced) {
+      entries[hand].is_referenced = false;
+      hand = (hand + 1) % capacity;
+    }
+    index.erase(entries[hand].key);
+    stats.evictions++;
+    entries[hand] = {key, false, step};
+    index[key] = hand;
+    hand = (hand + 1) % capacity;
+  }
+
+  Stats get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+  }
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+};
+
+// Ratings of puzzles, stored in a file. File is an open-addressed table of
+// fixed size, mapped into memory, so lookup doesn't parse anything. Records
+// are only appended: key of the slot is written after the record, so readers
+// (also from other processes) never see half-written record. Only one
+// RatingCache can open the file for writing, it is locked with flock. Threads
+// can share one RatingCache, inserts are serialized.
+class RatingCache {
+public:
+  struct Record {
+    int32_t score = 0;
+    bool is_solved = false;
+    // see HumanSolver::methods_to_mask
+    uint32_t methods = 0;
+  };
+
+private:
+  struct Header {
+    char magic[8];
+    uint64_t capacity;
+    uint64_t count;
+  };
+  struct Slot {
+    // 0 if slot is empty
+    uint64_t key;
+    int32_t score;
+    uint32_t methods;
+    uint32_t is_solved;
+    uint32_t padding;
+  };
+  static constexpr char magic[8] = {'S', 'D', 'K', 'R', 'A', 'T', 'E', '1'};
+
+  int fd = -1;
+  void *data = nullptr;
+  size_t file_size = 0;
+  bool is_writable = false;
+  Header *header = nullptr;
+  Slot *slots = nullptr;
+  std::mutex insert_mutex;
+
+  static uint64_t slot_key(uint64_t key) { return key == 0 ? 1 : key; }
+  static size_t size_for(uint64_t capacity) {
+    return sizeof(Header) + capacity * sizeof(Slot);
+  }
+
+public:
+  RatingCache() = default;
+  RatingCache(const std::string &path, bool writable,
+              uint64_t capacity = 1 << 20) {
+    open(path, writable, capacity);
+  }
+  RatingCache(const RatingCache &) = delete;
+  RatingCache &operator=(const RatingCache &) = delete;
+  ~RatingCache() { close(); }
+
+  // Creates the file with room for capacity records (rounded up to power of
+  // 2), if it doesn't exist and writable is true. Returns false if file can't
+  // be opened, is not a rating cache or is already opened for writing.
+  bool open(const std::string &path, bool writable,
+            uint64_t capacity = 1 << 20) {
+    close();
+    fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    if (writable && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      close();
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close();
+      return false;
+    }
+    bool is_new = st.st_size == 0;
+    if (is_new) {
+      uint64_t rounded = 1;
+      while (rounded < capacity) {
+        rounded <<= 1;
+      }
+      if (!writable || ftruncate(fd, size_for(rounded)) != 0) {
+        close();
+        return false;
+      }
+      file_size = size_for(rounded);
+    } else if (size_t(st.st_size) >= sizeof(Header)) {
+      file_size = st.st_size;
+    } else {
+      close();
+      return false;
+    }
+    data = mmap(nullptr, file_size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      data = nullptr;
+      close();
+      return false;
+    }
+    is_writable = writable;
+    header = static_cast<Header *>(data);
+    slots = reinterpret_cast<Slot *>(header + 1);
+    if (is_new) {
+      header->capacity = (file_size - sizeof(Header)) / sizeof(Slot);
+      std::memcpy(header->magic, magic, sizeof(magic));
+    }
+    uint64_t capacity_in_file = header->capacity;
+    if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+        capacity_in_file == 0 ||
+        (capacity_in_file & (capacity_in_file - 1)) != 0 ||
+        size_for(capacity_in_file) != file_size) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  void close() {
+    if (data != nullptr) {
+      munmap(data, file_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+    data = nullptr;
+    header = nullptr;
+    slots = nullptr;
+    is_writable = false;
+  }
+  bool is_open() const { return data != nullptr; }
+
+  bool find(uint64_t key, Record &record) const {
+    if (!is_open()) {
+      return false;
+    }
+    key = slot_key(key);
+    uint64_t mask = header->capacity - 1;
+    // full (or corrupted) table has no empty slot to stop at
+    for (uint64_t probe = 0, i = key & mask; probe < header->capacity;
+         probe++, i = (i + 1) & mask) {
+      uint64_t slot = __atomic_load_n(&slots[i].key, __ATOMIC_ACQUIRE);
+      if (slot == 0) {
+        return false;
+      }
+      if (slot == key) {
+        record.score = slots[i].score;
+        record.is_solved = slots[i].is_solved;
+        record.methods = slots[i].methods;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns false if cache is opened only for reading, if key is already in
+  // cache or if cache is 3/4 full.
+  bool insert(uint64_t key, const Record &record) {
+    std::lock_guard<std::mutex> lock(insert_mutex);
+    if (!is_open() || !is_writable ||
+        (header->count + 1) * 4 > header->capacity * 3) {
+      return false;
+    }
+    key = slot_key(key);
+    uint64_t mask = header->capacity - 1;
+    uint64_t i = key & mask;
+    for (uint64_t probe = 0; slots[i].key != 0; probe++, i = (i + 1) & mask) {
+      if (slots[i].key == key || probe == header->capacity) {
+        return false;
+      }
+    }
+    slots[i].score = record.score;
+    slots[i].is_solved = record.is_solved;
+    slots[i].methods = record.methods;
+    __atomic_store_n(&slots[i].key, key, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->count, header->count + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  uint64_t size() const {
+    return is_open() ? __atomic_load_n(&header->count, __ATOMIC_ACQUIRE) : 0;
+  }
+  uint64_t capacity() const { return is_open() ? header->capacity : 0; }
+};
+
+class HumanSolver {
+private:
+  Puzzle puzzle;
+  std::map<std::string, int> method_scores_subsequent;
+  std::multimap<int, std::string> methods_score;
+  ForcingChains forcing_chains;
+  // uniqueness based methods are used only if puzzle has exactly 1 solution
+  bool is_unique;
+  // singles are placed by singles_sweep, not step by step
+  bool is_singles_sweep = true;
+  StepCache *step_cache = nullptr;
+  RatingCache *rating_cache = nullptr;
+  // solving stops, when it becomes true
+  const std::atomic<bool> *cancelled = nullptr;
+
+  bool is_cancelled() const { return cancelled != nullptr && *cancelled; }
+
+  bool single_candidate_spot() {
+    std::map<Pos, std::vector<int>> pencilmarks = puzzle.get_pencilmarks();
+    for (Pos pos : Figure(9, 9)) {
+      if (pencilmarks[pos].size() != 1) {
+        continue;
+      }
+      puzzle.set_clue(pos, pencilmarks[pos][0]);
+      std::cout << "single candidate (" << pencilmarks[pos][0]
+                << ") spotted at: " << pos << std::endl;
+      return true;
+    }
+    return false;
+  }
+  bool single_position_spot() {
+    std::map<Pos, std::vector<int>> pencilmarks = puzzle.get_pencilmarks();
+    auto find_single_position = [this, &pencilmarks](Figure figure) -> bool {
+      std::vector<int> single_position_pencilmarks =
+          puzzle.pencilmarks_with_count(figure, 1, 1);
+      if (single_position_pencilmarks.size() == 0) {
+        return false;
+      }
+      // get position of this pencilmark
+      Figure pencilmark_pos = puzzle.get_pencilmark_positions(
+          figure, single_position_pencilmarks[0]);
+      puzzle.set_clue(pencilmark_pos[0], single_position_pencilmarks[0]);
+      std::cout << "single position (" << single_position_pencilmarks[0]
+                << ") spotted at: " << pencilmark_pos[0] << std::endl;
+      return true;
+    };
+    for (int number = 0; number < 9; number++) {
+
+      Figure col = Figure().col(number);
+      Figure row = Figure().row(number);
+      Figure square = Figure().square(number);
+
+      if (find_single_position(square) || find_single_position(col) ||
+          find_single_position(row)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool candidate_lines_spot() {
+    for (int square_number = 0; square_number < 9; square_number++) {
+      // counting all numbers in square pencilmarks
+      Figure square = Figure().square(square_number);
+      // finding numbers, which count in square equals to 2
+      std::vector<int> clues_count =
+          puzzle.pencilmarks_with_count(square, 2, 2);
+      for (int clue : clues_count) {
+
+        Figure numbers_position = puzzle.get_pencilmark_positions(square, clue);
+
+        Figure positions_to_blacklist;
+        if (numbers_position[0].col == numbers_position[1].col) {
+          positions_to_blacklist = Figure().col(numbers_position[0].col);
+        } else if (numbers_position[0].row == numbers_position[1].row) {
+          positions_to_blacklist = Figure().row(numbers_position[0].row);
+        }
+        // if they aren't on the same row or col, skip this number
+        else {
+          continue;
+        }
+        // remove first and second number positions (they are guaranteed to be
+        // in blacklist)
+        positions_to_blacklist.remove(numbers_position);
+
+        if (!puzzle.remove_pencilmarks(positions_to_blacklist, clue)) {
+          continue;
+        }
+
+        std::cout << "candidate line (" << clue
+                  << ") spotted at: " << numbers_position[0] << " and "
+                  << numbers_position[1] << std::endl;
+
+        return true;
+      }
+    }
+    return false;
+  }
+  struct OccupiedColsAndRows {
+    // cols_and_rows[0] - cols
+    // cols_and_rows[1] - rows
+    std::vector<int> cols_and_rows[2];
+    int number;
+  };
+  std::vector<OccupiedColsAndRows>
+  candidates_for_dpt_or_mlt(Figure &figure,
+                            std::vector<int> pencilmarks_candidates) {
+    std::vector<OccupiedColsAndRows> res;
+
+    for (int pencilmark : pencilmarks_candidates) {
+      Figure pencilmarks_position =
+          puzzle.get_pencilmark_positions(figure, pencilmark);
+
+      OccupiedColsAndRows to_push;
+      to_push.number = pencilmark;
+      std::vector<int> cols_occupied;
+      std::vector<int> rows_occupied;
+
+      {
+        std::set<int> cols_occupied_set =
+            pencilmarks_position.get_cols_occupied();
+        cols_occupied = std::vector<int>(cols_occupied_set.begin(),
+                                         cols_occupied_set.end());
+
+        std::set<int> rows_occupied_set =
+            pencilmarks_position.get_rows_occupied();
+        rows_occupied = std::vector<int>(rows_occupied_set.begin(),
+                                         rows_occupied_set.end());
+      }
+
+      if (cols_occupied.size() == 2) {
+        to_push.cols_and_rows[0] = cols_occupied;
+      }
+      if (rows_occupied.size() == 2) {
+        to_push.cols_and_rows[1] = rows_occupied;
+      }
+      res.push_back(to_push);
+    }
+    return res;
+  };
+  bool double_pairs_or_multiple_lines_spot(bool double_pairs) {
+    std::map<int, std::vector<OccupiedColsAndRows>> candidates;
+
+    for (int square_number = 0; square_number < 9; square_number++) {
+      Figure square = Figure().square(square_number);
+      std::vector<int> pencilmarks;
+      if (double_pairs) {
+        pencilmarks = puzzle.pencilmarks_with_count(square, 2, 2);
+      } else {
+        pencilmarks = puzzle.pencilmarks_with_count(square, 2, 6);
+      }
+      candidates[square_number] =
+          candidates_for_dpt_or_mlt(square, pencilmarks);
+    }
+
+    auto print_founded = [double_pairs](OccupiedColsAndRows candidate,
+                                        int square_number1,
+                                        int square_number2) {
+      if (double_pairs) {
+        std::cout << "double pairs";
+      } else {
+        std::cout << "multiply lines";
+      }
+      std::cout << " (" << candidate.number
+                << ") spotted in squares: " << square_number1 << " and "
+                << square_number2 << std::endl;
+    };
+
+    auto next_square_in_col = [](int square1, int square2) {
+      int square_col = square1 % 3;
+      while (square1 == square_col || square2 == square_col) {
+        square_col += 3;
+      }
+      return square_col;
+    };
+
+    auto next_square_in_row = [](int square1, int square2) {
+      int square_row = (square1 / 3) * 3;
+      while (square1 == square_row || square2 == square_row) {
+        square_row += 1;
+      }
+      return square_row;
+    };
+
+    auto check = [this, next_square_in_row, next_square_in_col,
+                  print_founded](OccupiedColsAndRows c1, OccupiedColsAndRows c2,
+                                 int square1, int square2) {
+      if (c1.number != c2.number) {
+        return false;
+      }
+
+      // i=0 - checking cols
+      // i=1 - checking rows
+      for (int i = 0; i < 2; i++) {
+        if (c1.cols_and_rows[i] == c2.cols_and_rows[i] &&
+            c1.cols_and_rows[i].size() != 0) {
+          Figure cols_or_rows;
+          Figure figure_to_remove_from;
+          if (i == 0) {
+            cols_or_rows = Figure()
+                               .col(c1.cols_and_rows[i][0])
+                               .col(c1.cols_and_rows[i][1]);
+            figure_to_remove_from =
+                Figure().square(next_square_in_col(square1, square2));
+          } else {
+            cols_or_rows = Figure()
+                               .row(c1.cols_and_rows[i][0])
+                               .row(c1.cols_and_rows[i][1]);
+            figure_to_remove_from =
+                Figure().square(next_square_in_row(square1, square2));
+          }
+
+          figure_to_remove_from =
+              Figure::intersect(figure_to_remove_from, cols_or_rows);
+
+          if (!puzzle.remove_pencilmarks(figure_to_remove_from, c1.number)) {
+            continue;
+          }
+          print_founded(c1, square1, square2);
+          return true;
+        }
+      }
+      return false;
+    };
+
+    // TODO: optimize that loop
+    for (int square_number1 = 0; square_number1 < 8; square_number1++) {
+      for (OccupiedColsAndRows candidate1 : candidates[square_number1]) {
+
+        for (int square_number2 = square_number1 + 1; square_number2 < 9;
+             square_number2++) {
+          for (OccupiedColsAndRows candidate2 : candidates[square_number2]) {
+
+            if (check(candidate1, candidate2, square_number1, square_number2)) {
+              return true;
+            }
+          }
+        }
+      }
+    }
+
+    return false;
+  }
+  bool naked_nth_spot(int N) {
+    auto find_in_figure = [N, this](Figure figure) {
+      Figure optimized_figure = figure;
+      std::map<Pos, std::vector<int>> pencilmarks =
+          puzzle.get_pencilmarks(optimized_figure);
+
+      for (auto pencilmark : pencilmarks) {
+        if (pencilmark.second.size() > N || pencilmark.second.size() == 0) {
+          optimized_figure.erase(pencilmark.first);
+        }
+      }
+
+      if (optimized_figure.size() < N) {
+        return false;
+      }
+      Utility::NDIncrementCount possible_pos{N, optimized_figure.size()};
+
+      while (possible_pos.increment()) {
+
+        Figure sub_figure =
+            optimized_figure.sub_figure(possible_pos.get_positions());
+
+        std::set<int> set_of_pencilmarks =
+            puzzle.get_pencilmarks_set(sub_figure);
+
+        if (set_of_pencilmarks.size() == N) {
+          bool is_pencilmarks_removed = false;
+          Figure figure_to_remove = figure;
+          figure_to_remove.remove(sub_figure);
+          for (int pencilmark : set_of_pencilmarks) {
+            if (puzzle.remove_pencilmarks(figure_to_remove, pencilmark)) {
+              is_pencilmarks_removed = true;
+            }
+          }
+          if (!is_pencilmarks_removed) {
+            continue;
+          }
+          std::cout << "naked " << N << " (";
+          for (int pencilmark : set_of_pencilmarks) {
+            std::cout << pencilmark << ", ";
+          }
+          std::cout << "\b\b) spotted at: " << sub_figure << std::endl;
+          return true;
+        }
+      }
+      return false;
+    };
+    for (int figure_number = 0; figure_number < 9; figure_number++) {
+      Figure col = Figure().col(figure_number);
+      Figure row = Figure().row(figure_number);
+      Figure square = Figure().square(figure_number);
+      if (find_in_figure(col) || find_in_figure(row) ||
+          find_in_figure(square)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool hidden_nth_spot(int N) {
+    auto find_in_figure = [N, this](Figure figure) {
+      Figure optimized_figure = figure;
+      std::map<Pos, std::vector<int>> pencilmarks =
+          puzzle.get_pencilmarks(optimized_figure);
+
+      for (auto pencilmark : pencilmarks) {
+        // TODO: insert in Puzzle::get_pencilmarks function.
+        if (pencilmark.second.size() == 0) {
+          optimized_figure.erase(pencilmark.first);
+        }
+      }
+
+      if (optimized_figure.size() < N) {
+        return false;
+      }
+
+      std::vector<int> set_of_pencilmarks =
+          puzzle.pencilmarks_with_count(optimized_figure, 2, N);
+
+      if (set_of_pencilmarks.size() < N) {
+        return false;
+      }
+
+      Utility::NDIncrementCount possible_pos{N, set_of_pencilmarks.size()};
+
+      while (possible_pos.increment()) {
+        Figure sub_figure;
+        for (int i : possible_pos.get_positions()) {
+          Figure figure_to_insert =
+              puzzle.get_pencilmark_positions(figure, set_of_pencilmarks[i]);
+          sub_figure.insert(figure_to_insert.begin(), figure_to_insert.end());
+        }
+
+        if (sub_figure.size() == N) {
+          std::vector<int> pencilmarks_to_left;
+          for (int i : possible_pos.get_positions()) {
+            pencilmarks_to_left.push_back(set_of_pencilmarks[i]);
+          }
+          if (!puzzle.remove_all_pencilmarks_except(sub_figure,
+                                                    pencilmarks_to_left)) {
+            continue;
+          }
+          std::cout << "hidden " << N << " (";
+          for (int i : possible_pos.get_positions()) {
+            std::cout << set_of_pencilmarks[i] << ", ";
+          }
+          std::cout << "\b\b) spotted at: " << sub_figure << std::endl;
+          return true;
+        }
+      }
+      return false;
+    };
+    for (int figure_number = 0; figure_number < 9; figure_number++) {
+      Figure col = Figure().col(figure_number);
+      Figure row = Figure().row(figure_number);
+      Figure square = Figure().square(figure_number);
+      if (find_in_figure(col) || find_in_figure(row) ||
+          find_in_figure(square)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  class XWingCandidate {
+  public:
+    bool is_row;
+    int digit;
+    Figure positions;
+    bool is_situable(XWingCandidate &other) {
+      if (is_row != other.is_row || digit != other.digit) {
+        return false;
+      }
+      if (is_row) {
+        return positions[0].col == other.positions[0].col &&
+               positions[1].col == other.positions[1].col;
+      }
+      return positions[0].row == other.positions[0].row &&
+             positions[1].row == other.positions[1].row;
+    }
+  };
+  bool xwing_spot() {
+    // TODO: Optimizable. Use std::map<std::vector<XWingCandidate>>, where key
+    // is the digit
+    std::vector<XWingCandidate> candidates;
+    auto add_candidates_from_figure = [&candidates, this](Figure &f,
+                                                          bool is_row) {
+      std::vector<int> pencilmarks_with_count_2 =
+          puzzle.pencilmarks_with_count(f, 2, 2);
+      for (int pencilmark : pencilmarks_with_count_2) {
+        Figure positions = puzzle.get_pencilmark_positions(f, pencilmark);
+        candidates.push_back({});
+        candidates.back().is_row = is_row;
+        candidates.back().digit = pencilmark;
+        candidates.back().positions = positions;
+      }
+    };
+    auto founded = [this](XWingCandidate candidate, Figure positions_involved) {
+      Figure positions_to_remove_from;
+      for (Pos pos : positions_involved) {
+        Figure f;
+        if (candidate.is_row) {
+          f = Figure().col(pos.col);
+        } else {
+          f = Figure().row(pos.row);
+        }
+        positions_to_remove_from.insert(f.begin(), f.end());
+      }
+      positions_to_remove_from.remove(positions_involved);
+      if (!puzzle.remove_pencilmarks(positions_to_remove_from,
+                                     candidate.digit)) {
+        return false;
+      }
+      std::cout << "x-wing (" << candidate.digit << ") found at "
+                << positions_involved << std::endl;
+      return true;
+    };
+    for (int i = 0; i < 9; i++) {
+      Figure row = Figure().row(i);
+      Figure col = Figure().col(i);
+      add_candidates_from_figure(row, true);
+      add_candidates_from_figure(col, false);
+    }
+		if (candidates.size() == 0){ return false; }
+    for (int i = 0; i < candidates.size() - 1; i++) {
+      XWingCandidate candidate1 = candidates[i];
+      for (int j = i + 1; j < candidates.size(); j++) {
+        XWingCandidate candidate2 = candidates[j];
+        if (candidate1.is_situable(candidate2)) {
+          Figure positions_involved = candidate1.positions;
+          positions_involved.insert(candidate2.positions.begin(),
+                                    candidate2.positions.end());
+          if (!founded(candidate1, positions_involved)) {
+            continue;
+          }
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  // everything except pencilmarks, that affects the next step: order of
+  // methods and their settings
+  uint64_t state_hash() {
+    std::vector<uint32_t> state;
+    const std::vector<std::string> &names = method_names();
+    for (auto method : methods_score) {
+      state.push_back(
+          std::find(names.begin(), names.end(), method.second) - names.begin());
+    }
+    ForcingChains::Limits limits = forcing_chains.get_limits();
+    state.push_back(is_unique);
+    state.push_back(limits.max_depth);
+    state.push_back(limits.max_nodes);
+    return Utility::hash64(state.data(), state.size() * sizeof(uint32_t));
+  }
+  bool forcing_chains_spot() {
+    forcing_chains.update(CandidateGrid(puzzle));
+    ForcingChains::Chain chain;
+    if (!forcing_chains.find(chain)) {
+      return false;
+    }
+    for (std::pair<Pos, int> elimination : chain.eliminations) {
+      puzzle.remove_pencilmark_from_cell(elimination.first, elimination.second);
+    }
+    std::cout << "forcing chain (" << chain.digit << (chain.is_on ? " on" : " off")
+              << ") spotted from: " << chain.start << std::endl;
+    return true;
+  }
+
+  bool unique_rectangle_spot() {
+    CandidateGrid grid(puzzle);
+    Bitboard bivalue;
+    for (int index = 0; index < 81; index++) {
+      if (__builtin_popcount(grid.candidates[index]) == 2) {
+        bivalue.set(index);
+      }
+    }
+
+    auto eliminate = [this](Bitboard cells, uint16_t digits) {
+      bool is_pencilmarks_removed = false;
+      cells.for_each([this, digits, &is_pencilmarks_removed](int index) {
+        for (int digit = 1; digit <= 9; digit++) {
+          if ((digits & (1 << (digit - 1))) &&
+              puzzle.remove_pencilmark_from_cell(Pos::from_index(index),
+                                                 digit)) {
+            is_pencilmarks_removed = true;
+          }
+        }
+      });
+      return is_pencilmarks_removed;
+    };
+    auto founded = [](int type, uint16_t pair, Bitboard cells) {
+      std::cout << "unique rectangle type " << type << " (";
+      for (int digit = 1; digit <= 9; digit++) {
+        if (pair & (1 << (digit - 1))) {
+          std::cout << digit << ", ";
+        }
+      }
+      std::cout << "\b\b) spotted at: " << cells.to_figure() << std::endl;
+    };
+    // houses, that contain both cells
+    auto common_houses = [](int index1, int index2) {
+      std::vector<int> res;
+      for (int house : Tables::houses_of(index1)) {
+        if (Tables::houses[house].test(index2)) {
+          res.push_back(house);
+        }
+      }
+      return res;
+    };
+
+    for (const std::array<uint8_t, 4> &rectangle : Tables::rectangles) {
+      Bitboard corners;
+      for (int index : rectangle) {
+        corners.set(index);
+      }
+      Bitboard floor = corners & bivalue;
+      if (floor.empty()) {
+        continue;
+      }
+      uint16_t pair = grid.candidates[floor.first()];
+      bool is_deadly = true;
+      floor.for_each([&grid, &is_deadly, pair](int index) {
+        is_deadly = is_deadly && grid.candidates[index] == pair;
+      });
+      for (int index : rectangle) {
+        is_deadly = is_deadly && (grid.candidates[index] & pair) == pair;
+      }
+      if (!is_deadly) {
+        continue;
+      }
+      Bitboard roof = corners.and_not(floor);
+
+      if (roof.count() == 1) {
+        if (eliminate(roof, pair)) {
+          founded(1, pair, corners);
+          return true;
+        }
+        continue;
+      }
+      if (roof.count() != 2) {
+        continue;
+      }
+      int roof1 = roof.first();
+      int roof2 = roof.and_not(Bitboard::cell(roof1)).first();
+      std::vector<int> houses = common_houses(roof1, roof2);
+      // roof cells lie on the diagonal of the rectangle
+      if (houses.empty()) {
+        continue;
+      }
+      uint16_t extra1 = grid.candidates[roof1] & ~pair;
+      uint16_t extra2 = grid.candidates[roof2] & ~pair;
+
+      // type 2: one extra candidate in both roof cells
+      if (extra1 == extra2 && __builtin_popcount(extra1) == 1) {
+        Bitboard seen_by_roof =
+            Tables::peers[roof1] & Tables::peers[roof2] & ~corners;
+        if (eliminate(seen_by_roof, extra1)) {
+          founded(2, pair, corners);
+          return true;
+        }
+      }
+
+      for (int house : houses) {
+        Bitboard others = Tables::houses[house].and_not(corners);
+        Bitboard unsolved;
+        others.for_each([&grid, &unsolved](int index) {
+          if (grid.candidates[index] != 0) {
+            unsolved.set(index);
+          }
+        });
+
+        // type 3: roof cells act as one cell with extra candidates, that forms
+        // naked subset with other cells of the house
+        uint16_t extra = extra1 | extra2;
+        std::vector<int> cells;
+        unsolved.for_each([&cells](int index) { cells.push_back(index); });
+        for (int size = 1; size <= 3 && size <= (int)cells.size(); size++) {
+          Utility::NDIncrementCount possible_pos{size, cells.size()};
+          while (possible_pos.increment()) {
+            uint16_t digits = extra;
+            Bitboard subset;
+            for (int i : possible_pos.get_positions()) {
+              digits |= grid.candidates[cells[i]];
+              subset.set(cells[i]);
+            }
+            if (__builtin_popcount(digits) != size + 1) {
+              continue;
+            }
+            if (eliminate(unsolved.and_not(subset), digits)) {
+              founded(3, pair, corners | subset);
+              return true;
+            }
+          }
+        }
+
+        // type 4: one digit of the pair is locked in roof cells, so the other
+        // can't be there
+        for (int digit = 1; digit <= 9; digit++) {
+          uint16_t bit = 1 << (digit - 1);
+          if (!(pair & bit)) {
+            continue;
+          }
+          bool is_locked = true;
+          unsolved.for_each([&grid, &is_locked, bit](int index) {
+            is_locked = is_locked && !(grid.candidates[index] & bit);
+          });
+          if (is_locked && eliminate(roof, pair & ~bit)) {
+            founded(4, pair, corners);
+            return true;
+          }
+        }
+      }
+    }
+    return false;
+  }
+  bool bug_spot() {
+    CandidateGrid grid(puzzle);
+    int bug_cell = -1;
+    for (int index = 0; index < 81; index++) {
+      int count = __builtin_popcount(grid.candidates[index]);
+      if (count == 0 || count == 2) {
+        continue;
+      }
+      if (count != 3 || bug_cell != -1) {
+        return false;
+      }
+      bug_cell = index;
+    }
+    if (bug_cell == -1) {
+      return false;
+    }
+    // every digit must appear twice in every house, except the digit of the
+    // bug cell, which appears three times in the houses of this cell
+    std::array<Bitboard, 9> planes;
+    for (int digit = 1; digit <= 9; digit++) {
+      planes[digit - 1] = grid.plane(digit);
+    }
+    int bug_digit = 0;
+    for (int house = 0; house < 27; house++) {
+      for (int digit = 1; digit <= 9; digit++) {
+        int count = (Tables::houses[house] & planes[digit - 1]).count();
+        if (count == 0 || count == 2) {
+          continue;
+        }
+        if (count != 3 || !Tables::houses[house].test(bug_cell) ||
+            (bug_digit != 0 && bug_digit != digit)) {
+          return false;
+        }
+        bug_digit = digit;
+      }
+    }
+    if (bug_digit == 0) {
+      return false;
+    }
+    for (int digit = 1; digit <= 9; digit++) {
+      if (digit != bug_digit) {
+        puzzle.remove_pencilmark_from_cell(Pos::from_index(bug_cell), digit);
+      }
+    }
+    std::cout << "bug+1 (" << bug_digit
+              << ") spotted at: " << Pos::from_index(bug_cell) << std::endl;
+    return true;
+  }
+
+  bool set_equivalence_spot() {
+    CandidateGrid grid(puzzle);
+    std::array<Bitboard, 9> planes, clue_planes;
+    for (int digit = 1; digit <= 9; digit++) {
+      planes[digit - 1] = grid.plane(digit);
+      clue_planes[digit - 1] = grid.clue_plane(digit);
+    }
+    // maximum times digit can appear in cells: it can't be twice in one house
+    auto max_count = [](Bitboard cells) {
+      int res[3] = {};
+      for (int house = 0; house < 27; house++) {
+        if (!(Tables::houses[house] & cells).empty()) {
+          res[house / 9]++;
+        }
+      }
+      return std::min({res[0], res[1], res[2]});
+    };
+
+    for (const Tables::SetEquivalence &equivalence : Tables::set_equivalences) {
+      for (int digit = 1; digit <= 9; digit++) {
+        Bitboard plane = planes[digit - 1];
+        Bitboard clue_plane = clue_planes[digit - 1];
+        // if digit is already placed in one set as many times as it can be in
+        // the other one, all its pencilmarks in the first set are wrong
+        for (int direction = 0; direction < 2; direction++) {
+          Bitboard from = direction ? equivalence.second : equivalence.first;
+          Bitboard to = direction ? equivalence.first : equivalence.second;
+          Bitboard to_remove = to & plane;
+          if (to_remove.empty() ||
+              (to & clue_plane).count() < max_count(from & (plane | clue_plane))) {
+            continue;
+          }
+          Figure figure = to_remove.to_figure();
+          puzzle.remove_pencilmarks(figure, digit);
+          std::cout << equivalence.name << " (" << digit
+                    << ") spotted at: " << figure << std::endl;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+public:
+  class Result {
+  public:
+    int score = 0;
+    bool is_solved = false;
+    std::set<std::string> used_methods;
+    bool operator==(Result const &other) {
+      return other.score == score && other.is_solved == is_solved &&
+             other.used_methods == used_methods;
+    };
+    bool operator!=(Result const &other) { return !(*this == other); }
+    friend std::ostream &operator<<(std::ostream &os,
+                                    const Result &solver_res) {
+      os << "Score: " << solver_res.score << std::endl;
+      os << "Is solved: " << solver_res.is_solved << std::endl;
+      os << "Used methods: {";
+      for (std::string used_method : solver_res.used_methods) {
+        std::cout << "\"" << used_method << "\", ";
+      }
+      os << "\b\b}" << std::endl;
+      return os;
+    }
+  };
+  // Set is_unique to true only if puzzle is known to have exactly 1 solution
+  // (for example, puzzle is made by Generator or checked with
+  // TdokuLib::has_unique_solution). Otherwise uniqueness based methods can
+  // remove right pencilmarks.
+  HumanSolver(Puzzle _puzzle, bool is_unique = false)
+      : HumanSolver(_puzzle, is_unique, nullptr) {
+		puzzle.generate_pencilmarks();
+  }
+  // Solver of the game in progress: pencilmarks of the state are kept, so
+  // eliminations of the player are respected.
+  static HumanSolver from_state(const Puzzle &state, bool is_unique = false) {
+    return HumanSolver(state, is_unique, nullptr);
+  }
+
+private:
+  // keeps pencilmarks of the puzzle
+  HumanSolver(const Puzzle &_puzzle, bool is_unique, std::nullptr_t)
+      : puzzle{_puzzle}, is_unique{is_unique} {
+    methods_score = {
+        {10, "Single Candidate"}, {10, "Single Position"},
+        {35, "Candidate Lines"},  {50, "Double Pairs"},
+        {70, "Multiple Lines"},   {75, "Naked Pair"},
+        {150, "Hidden Pair"},     {200, "Naked Triple"},
+        {240, "Hidden Triple"},   {250, "Unique Rectangle"},
+        {260, "BUG+1"},           {280, "X-Wing"},
+        {300, "Set Equivalence"}, {420, "Forcing Chains"},
+        {500, "Naked Quad"},      {700, "Hidden Quad"},
+        {800, "Swordfish"},
+    };
+
+    method_scores_subsequent = {
+        {"Single Candidate", 10}, {"Single Position", 10},
+        {"Candidate Lines", 20},  {"Double Pairs", 25},
+        {"Multiple Lines", 40},   {"Naked Pair", 50},
+        {"Hidden Pair", 120},     {"Naked Triple", 140},
+        {"Hidden Triple", 160},   {"Unique Rectangle", 130},
+        {"BUG+1", 140},           {"X-Wing", 160},
+        {"Set Equivalence", 180}, {"Forcing Chains", 210},
+        {"Naked Quad", 400},      {"Hidden Quad", 500},
+        {"Swordfish", 600},
+    };
+  }
+
+public:
+  // All methods HumanSolver knows. Index of method in this list is its bit in
+  // methods mask.
+  static const std::vector<std::string> &method_names() {
+    static const std::vector<std::string> names = {
+        "Single Candidate", "Single Position",  "Candidate Lines",
+        "Double Pairs",     "Multiple Lines",   "Naked Pair",
+        "Hidden Pair",      "Naked Triple",     "Hidden Triple",
+        "Unique Rectangle", "BUG+1",            "X-Wing",
+        "Set Equivalence",  "Forcing Chains",   "Naked Quad",
+        "Hidden Quad",      "Swordfish",
+    };
+    return names;
+  }
+  static uint32_t methods_to_mask(const std::set<std::string> &methods) {
+    uint32_t mask = 0;
+    const std::vector<std::string> &names = method_names();
+    for (size_t i = 0; i < names.size(); i++) {
+      if (methods.count(names[i]) != 0) {
+        mask |= 1u << i;
+      }
+    }
+    return mask;
+  }
+  static std::set<std::string> mask_to_methods(uint32_t mask) {
+    std::set<std::string> methods;
+    const std::vector<std::string> &names = method_names();
+    for (size_t i = 0; i < names.size(); i++) {
+      if (mask & (1u << i)) {
+        methods.insert(names[i]);
+      }
+    }
+    return methods;
+  }
+
+  // cells of houses in order of single_position_spot: square, col and row of
+  // every number
+  static constexpr std::array<std::array<uint8_t, 9>, 27> single_position_houses =
+      [] {
+        std::array<std::array<uint8_t, 9>, 27> res{};
+        for (int number = 0; number < 9; number++) {
+          for (int i = 0; i < 9; i++) {
+            res[number * 3][i] = ((number / 3) * 3 + i / 3) * 9 +
+                                 (number % 3) * 3 + i % 3;
+            res[number * 3 + 1][i] = i * 9 + number;
+            res[number * 3 + 2][i] = number * 9 + i;
+          }
+        }
+        return res;
+      }();
+
+  // Places singles, until there are none, on bit masks of candidates. Score
+  // and methods are the same as of single_candidate_spot and
+  // single_position_spot, called step by step: all naked singles are placed
+  // in one pass over cells (and passes repeat), hidden single is the first
+  // one, that single_position_spot finds ("seen once and not seen more"
+  // masks of houses), and after it naked singles are looked for again.
+  // Returns false if no single was placed.
+  bool singles_sweep(Result &res) {
+    CandidateGrid grid(puzzle);
+    bool is_placed = false;
+    auto place = [&](int index, int digit) {
+      grid.clues[index] = digit;
+      grid.candidates[index] = 0;
+      Tables::peers[index].for_each([&grid, digit](int peer) {
+        grid.candidates[peer] &= ~(1 << (digit - 1));
+      });
+      puzzle.set_clue(Pos::from_index(index), digit);
+      is_placed = true;
+    };
+    while (true) {
+      bool is_naked_placed = false;
+      for (int index = 0; index < 81; index++) {
+        uint16_t candidates = grid.candidates[index];
+        if (grid.clues[index] == 0 && candidates != 0 &&
+            (candidates & (candidates - 1)) == 0) {
+          int digit = __builtin_ctz(candidates) + 1;
+          place(index, digit);
+          std::cout << "single candidate (" << digit
+                    << ") spotted at: " << Pos::from_index(index) << std::endl;
+          update_result_and_methods(res, "Single Candidate");
+          is_naked_placed = true;
+        }
+      }
+      if (is_naked_placed) {
+        continue;
+      }
+      bool is_hidden_placed = false;
+      for (const std::array<uint8_t, 9> &house : single_position_houses) {
+        uint16_t once = 0, more = 0;
+        for (int index : house) {
+          more |= once & grid.candidates[index];
+          once |= grid.candidates[index];
+        }
+        uint16_t single = once & ~more;
+        if (single == 0) {
+          continue;
+        }
+        single &= -single;
+        for (int index : house) {
+          if (grid.candidates[index] & single) {
+            int digit = __builtin_ctz(single) + 1;
+            place(index, digit);
+            std::cout << "single position (" << digit
+                      << ") spotted at: " << Pos::from_index(index)
+                      << std::endl;
+            update_result_and_methods(res, "Single Position");
+            break;
+          }
+        }
+        is_hidden_placed = true;
+        break;
+      }
+      if (!is_hidden_placed) {
+        return is_placed;
+      }
+    }
+  }
+
+  std::string solving_step(Result &res) {
+    if (step_cache == nullptr) {
+      return apply_methods();
+    }
+    CandidateGrid before(puzzle);
+    uint64_t key = before.hash() ^ Utility::mix64(state_hash());
+    SolvingStep step;
+    if (step_cache->find(key, step)) {
+      step.apply(puzzle);
+      std::cout << "cached step (" << step.method << ")" << std::endl;
+      return step.method;
+    }
+    std::string used_method = apply_methods();
+    step_cache->insert(key, SolvingStep(used_method, before, CandidateGrid(puzzle)));
+    return used_method;
+  }
+  std::string apply_methods() {
+    for (auto method : methods_score) {
+      if (method.second == "Single Candidate" && single_candidate_spot()) {
+        return method.second;
+      } else if (method.second == "Single Position" && single_position_spot()) {
+        return method.second;
+      } else if (method.second == "Candidate Lines" && candidate_lines_spot()) {
+        return method.second;
+      } else if (method.second == "Double Pairs" &&
+                 double_pairs_or_multiple_lines_spot(true)) {
+        return method.second;
+      } else if (method.second == "Multiple Lines" &&
+                 double_pairs_or_multiple_lines_spot(false)) {
+        return method.second;
+      } else if (method.second == "Naked Pair" && naked_nth_spot(2)) {
+        return method.second;
+      } else if (method.second == "Hidden Pair" && hidden_nth_spot(2)) {
+        return method.second;
+      } else if (method.second == "Naked Triple" && naked_nth_spot(3)) {
+        return method.second;
+      } else if (method.second == "Hidden Triple" && hidden_nth_spot(3)) {
+        return method.second;
+      } else if (method.second == "Naked Quad" && naked_nth_spot(4)) {
+        return method.second;
+      } else if (method.second == "Hidden Quad" && hidden_nth_spot(4)) {
+        return method.second;
+      } else if (method.second == "X-Wing" && xwing_spot()) {
+        return method.second;
+      } else if (method.second == "Unique Rectangle" && is_unique &&
+                 unique_rectangle_spot()) {
+        return method.second;
+      } else if (method.second == "BUG+1" && is_unique && bug_spot()) {
+        return method.second;
+      } else if (method.second == "Set Equivalence" &&
+                 set_equivalence_spot()) {
+        return method.second;
+      } else if (method.second == "Forcing Chains" && forcing_chains_spot()) {
+        return method.second;
+      }
+    }
+
+    std::cout << "can't solve this puzzle!:(\n";
+    puzzle.print_clues();
+    puzzle.print_pencilmarks();
+    return "";
+  }
+  void update_result_and_methods(Result &res, std::string used_method) {
+    res.used_methods.insert(used_method);
+    auto it_to_remove = methods_score.end();
+    for (auto it = methods_score.begin(); it != methods_score.end(); it++) {
+      if (it->second == used_method) {
+        res.score += it->first;
+        if (it->first != method_scores_subsequent[used_method]) {
+          it_to_remove = it;
+        }
+        break;
+      }
+    }
+    if (it_to_remove != methods_score.end()) {
+      methods_score.erase(it_to_remove);
+      methods_score.emplace(method_scores_subsequent[used_method], used_method);
+    }
+  }
+
+  // Rating cache is keyed by the clues (score and methods of equivalent
+  // puzzles may differ), so result is the same as without cache.
+  Result solve() {
+    if (rating_cache == nullptr) {
+      return solve_without_cache();
+    }
+    std::string clues = puzzle.clues_as_string();
+    uint64_t key = Utility::hash64(clues.data(), clues.size()) ^
+                   Utility::mix64(state_hash());
+    RatingCache::Record record;
+    if (rating_cache->find(key, record)) {
+      std::cout << "cached rating: " << record.score << std::endl;
+      return {record.score, record.is_solved, mask_to_methods(record.methods)};
+    }
+    Result res = solve_without_cache();
+    if (is_cancelled()) {
+      return res;
+    }
+    rating_cache->insert(
+        key, {res.score, res.is_solved, methods_to_mask(res.used_methods)});
+    return res;
+  }
+  Result solve_without_cache() {
+    Result res = {};
+    std::cout << "solving: " << std::endl;
+    puzzle.print_clues();
+    while (puzzle.is_space_for_clues_avalible()) {
+      if (is_cancelled()) {
+        return res;
+      }
+      // singles are the cheapest methods, so they are always tried first
+      if (is_singles_sweep && singles_sweep(res) &&
+          !puzzle.is_space_for_clues_avalible()) {
+        break;
+      }
+      std::string used_method = solving_step(res);
+      if (used_method == "") {
+        return res;
+      };
+      update_result_and_methods(res, used_method);
+    }
+    if (puzzle.is_solved()) {
+      std::cout << "solved!\nscore: " << res.score << std::endl;
+    }
+    res.is_solved = true;
+    return res;
+  }
+  // The easiest step, that can be applied now: methods are tried in order of
+  // their first-use scores and the order isn't changed by the step. Step is
+  // applied to the puzzle, its method is empty if nothing can be applied.
+  // With step cache, a step, that isn't cached, is followed by solving the
+  // rest of the path on a copy, every step of the path is cached. So the next
+  // hints of the game, that stays on the path, are lookups.
+  SolvingStep next_step() {
+    CandidateGrid before(puzzle);
+    uint64_t state = Utility::mix64(state_hash());
+    SolvingStep step;
+    if (step_cache != nullptr && step_cache->find(before.hash() ^ state, step)) {
+      step.apply(puzzle);
+      return step;
+    }
+    std::string used_method = apply_methods();
+    step = SolvingStep(used_method, before, CandidateGrid(puzzle));
+    if (step_cache == nullptr) {
+      return step;
+    }
+    step_cache->insert(before.hash() ^ state, step);
+    Puzzle after = puzzle;
+    for (std::string method = step.method;
+         method != "" && puzzle.is_space_for_clues_avalible() && !is_cancelled();) {
+      CandidateGrid grid(puzzle);
+      SolvingStep cached;
+      if (step_cache->find(grid.hash() ^ state, cached)) {
+        // the rest of the path is already cached
+        break;
+      }
+      method = apply_methods();
+      step_cache->insert(grid.hash() ^ state,
+                         SolvingStep(method, grid, CandidateGrid(puzzle)));
+    }
+    puzzle = after;
+    return step;
+  }
+  Puzzle &get_puzzle() { return puzzle; }
+  // Cache is consulted before every step. It must outlive HumanSolver.
+  void set_step_cache(StepCache *cache) { step_cache = cache; }
+  // Cache is consulted before solving. It must outlive HumanSolver.
+  void set_rating_cache(RatingCache *cache) { rating_cache = cache; }
+  // Solving stops before the next step, when flag becomes true. Result of
+  // stopped solving is not solved and is not cached.
+  void set_cancel_flag(const std::atomic<bool> *flag) { cancelled = flag; }
+  // Singles are placed step by step, like other methods, when it is false.
+  // Result is the same, so it is for checks and benchmarks of the sweep.
+  void set_singles_sweep(bool is_enabled) { is_singles_sweep = is_enabled; }
+  // bounds worst-case time of one Forcing Chains step
+  void set_forcing_chains_limits(ForcingChains::Limits limits) {
+    forcing_chains.set_limits(limits);
+  }
+};
+
+// Hints for games in progress. Hint is the next step of HumanSolver on the
+// state of the game with pencilmarks of the player. Solve paths are cached
+// by states (clues and pencilmarks), so repeated hints of games are lookups
+// while the player stays on a cached path. Can be shared between threads.
+class Hints {
+  StepCache cache;
+  bool is_unique;
+
+public:
+  // is_unique as in HumanSolver
+  explicit Hints(bool is_unique = false, size_t capacity = 1 << 16)
+      : cache{capacity}, is_unique{is_unique} {}
+
+  // step is not applied to the state, its method is empty if no method can
+  // be applied
+  SolvingStep next_step(const Puzzle &state) {
+    HumanSolver solver = HumanSolver::from_state(state, is_unique);
+    solver.set_step_cache(&cache);
+    return solver.next_step();
+  }
+  StepCache::Stats get_stats() { return cache.get_stats(); }
+};
+
+// Symmetry of clues of generated puzzles. Flags are maps of cells and can be
+// combined, puzzle is symmetric if every map keeps clues on clues.
+enum Symmetry : uint32_t {
+  no_symmetry = 0,
+  rotation_180 = 1,
+  // mirror by main diagonal (row and col are swapped)
+  diagonal = 2,
+  anti_diagonal = 4,
+  // mirror by horizontal axis (top and bottom rows are swapped)
+  horizontal = 8,
+  vertical = 16,
+  rotation_90 = 32,
+  // all 8 symmetries of square
+  dihedral = 63,
+};
+
+class TdokuLib{
+	Puzzle puzzle;
+	char cstr_puzzle[82];
+	void generate_cstr(){
+		std::string clues_string = puzzle.clues_as_string();
+		std::replace(clues_string.begin(), clues_string.end(), '0', '.');
+		if (clues_string.size() != 81) {return;}
+		strncpy(cstr_puzzle, clues_string.c_str(), 81);
+		cstr_puzzle[81] = '\0';
+	}
+public:
+	TdokuLib(Puzzle puzzle){
+		load(puzzle);
+	}
+	void load(Puzzle puzzle){
+		this->puzzle = puzzle;
+		generate_cstr();
+	}
+
+	int count_solutions(size_t limit = 99){
+		char solution[81];
+		size_t number_of_guesses = 0;
+		return Tdoku::SolveSudoku(cstr_puzzle, limit, 0, solution, &number_of_guesses);
+	}
+
+	bool has_unique_solution(){
+		return count_solutions(2) == 1;
+	}
+
+	Puzzle solve(){
+		Puzzle solved;
+
+		char solution[81];
+		size_t number_of_guesses = 0;
+
+		Tdoku::SolveSudoku(cstr_puzzle, 1, 0, solution, &number_of_guesses);
+		
+		solved.load(std::string(solution, 81));
+
+		return solved;
+	}
+	// returns false if puzzle has no solution
+	bool solve(Puzzle &solved){
+		char solution[81];
+		size_t number_of_guesses = 0;
+		if (Tdoku::SolveSudoku(cstr_puzzle, 1, 0, solution, &number_of_guesses) == 0){
+			return false;
+		}
+		return solved.load(std::string_view(solution, 81));
+	}
+
+	// clues are removed by orbits of symmetry (flags of Symmetry), so
+	// symmetric puzzle stays symmetric
+	std::string minimize(uint32_t symmetry = no_symmetry){
+		char res[81];
+		memcpy(res, cstr_puzzle, 81);
+		if (symmetry == no_symmetry){
+			Tdoku::TdokuMinimize(false, false, res);
+		}
+		else {
+			Tdoku::TdokuMinimizeSymmetric(false, symmetry, res);
+		}
+		return std::string(res, 81);
+	}
+};
+
+class Generator {
+private:
+  Puzzle puzzle;
+  Utility::CounterRng rg;
+  uint32_t symmetry = no_symmetry;
+
+  void fill_diagonals() {
+    for (int square_number = 0; square_number < 9; square_number += 4) {
+      std::vector<int> numbers;
+      numbers.resize(9);
+      std::iota(numbers.begin(), numbers.end(), 1);
+      Utility::shuffle(numbers.begin(), numbers.end(), rg);
+      Figure square = Figure().square(square_number);
+      for (Pos pos : square) {
+        puzzle.set_clue(pos, numbers.back());
+        numbers.pop_back();
+      }
+    }
+  }
+  bool fill(Pos pos) {
+    // if we reached end of the puzzle
+    if (pos == Pos{9, 8}) {
+      return true;
+    }
+    // if we reached end of the row
+    if (pos.col == 9) {
+      pos.row += 1;
+      pos.col = 0;
+    }
+    if (puzzle.get_clues()[pos] != 0) {
+      pos.col += 1;
+      return fill(pos);
+    }
+    for (int num = 1; num < 10; num++) {
+      if (puzzle.is_valid_clue(pos, num)) {
+        puzzle.set_clue(pos, num);
+        Pos pos_to_fill = pos;
+        pos_to_fill.col += 1;
+        if (fill(pos_to_fill)) {
+          return true;
+        }
+        puzzle.set_clue(pos, 0);
+      }
+    }
+    // No valid value was found, so backtrack
+    return false;
+  }
+
+	void minimize(){
+		// tdoku permutation of clues is a function of generator state too
+		Tdoku::TdokuSetSeed(rg());
+		TdokuLib tdoku(puzzle);
+		puzzle.load(tdoku.minimize(symmetry));
+	}
+
+public:
+  Generator(unsigned int seed = 0) {
+		set_seed(seed);
+	}
+	// puzzles of generator are a pure function of (seed, shard, index), so
+	// shards run without shared state and any puzzle can be made again alone
+	Generator(uint64_t seed, uint64_t shard, uint64_t index) {
+		set_seed(seed, shard, index);
+	}
+	// clues of generated puzzles are symmetric (flags of Symmetry), full grid
+	// is minimized by orbits, so no puzzle is rejected
+	void set_symmetry(uint32_t symmetry){
+		this->symmetry = symmetry;
+	}
+	void set_seed(unsigned int seed){
+		rg = Utility::CounterRng(seed);
+	}
+	void set_seed(uint64_t seed, uint64_t shard, uint64_t index){
+		rg = Utility::CounterRng(seed).split(shard).split(index);
+	}
+  Puzzle generate() {
+    puzzle = {};
+
+    fill_diagonals();
+    // starting from second square
+    fill({3, 0});
+
+		minimize();
+    return puzzle;
+  }
+  // Puzzle with clues exactly in cells of pattern (for shapes and letters).
+  // Every attempt is tdoku search with own stream, that gives up after
+  // max_counts counts of solutions. Attempts run in threads and the first
+  // successful one (by number) is taken, so puzzle depends only on seed.
+  // Returns false if no attempt found puzzle with unique solution.
+  bool generate_with_pattern(const Bitboard &pattern, Puzzle &res,
+                             size_t threads = 1, size_t attempts = 256,
+                             size_t max_counts = 1000) {
+    Utility::CounterRng attempts_rng = rg.split(rg());
+    std::atomic<size_t> next{0}, found{attempts};
+    std::mutex found_mutex;
+    std::string found_puzzle;
+    auto work = [&]() {
+      for (size_t attempt = next++; attempt < found; attempt = next++) {
+        char cells[81];
+        for (int cell = 0; cell < 81; cell++) {
+          cells[cell] = pattern.test(cell) ? 'x' : '.';
+        }
+        Tdoku::TdokuSetSeed(attempts_rng.split(attempt)());
+        if (Tdoku::TdokuConstrainPattern(cells, max_counts)) {
+          std::lock_guard<std::mutex> lock(found_mutex);
+          if (attempt < found) {
+            found = attempt;
+            found_puzzle.assign(cells, 81);
+          }
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, attempts); i++) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    return found != attempts && res.load(found_puzzle);
+  }
+};
+
+// Transformation of 9x9 puzzle, that keeps it valid and equivalent: digits
+// are relabeled, bands, stacks, rows inside bands and cols inside stacks are
+// permuted and grid may be transposed.
+class Transformation {
+private:
+  // digits[0] is 0, so empty cells stay empty
+  std::array<uint8_t, 10> digits{};
+  // cell (row, col) of result is cell (rows[row], cols[col]) of source
+  std::array<uint8_t, 9> rows{}, cols{};
+  bool is_transposed = false;
+
+  static void permute_lines(std::array<uint8_t, 9> &lines,
+                            Utility::CounterRng &rng) {
+    std::array<uint8_t, 3> blocks = {0, 1, 2};
+    Utility::shuffle(blocks.begin(), blocks.end(), rng);
+    for (int block = 0; block < 3; block++) {
+      std::array<uint8_t, 3> inner = {0, 1, 2};
+      Utility::shuffle(inner.begin(), inner.end(), rng);
+      for (int i = 0; i < 3; i++) {
+        lines[block * 3 + i] = blocks[block] * 3 + inner[i];
+      }
+    }
+  }
+
+public:
+  // identity
+  Transformation() {
+    std::iota(digits.begin(), digits.end(), 0);
+    std::iota(rows.begin(), rows.end(), 0);
+    std::iota(cols.begin(), cols.end(), 0);
+  }
+  static Transformation random(Utility::CounterRng &rng) {
+    Transformation res;
+    Utility::shuffle(res.digits.begin() + 1, res.digits.end(), rng);
+    permute_lines(res.rows, rng);
+    permute_lines(res.cols, rng);
+    res.is_transposed = rng() & 1;
+    return res;
+  }
+
+  // clues are 81 digits, '0' for empty cell
+  void apply(const char *clues, char *res) const {
+    for (int row = 0; row < 9; row++) {
+      for (int col = 0; col < 9; col++) {
+        int source = is_transposed ? cols[col] * 9 + rows[row]
+                                   : rows[row] * 9 + cols[col];
+        res[row * 9 + col] = '0' + digits[clues[source] - '0'];
+      }
+    }
+  }
+  Puzzle apply(Puzzle puzzle) const {
+    std::string clues = puzzle.clues_as_string(), res(81, '0');
+    apply(clues.data(), res.data());
+    return Puzzle(res);
+  }
+};
+
+// Makes many puzzles from one: equivalent puzzles (by random Transformations)
+// get rating of the source without solving. It is only an approximation of
+// their own ratings: HumanSolver finds methods in cell order, so score and
+// used methods of equivalent puzzle often differ (difficulty is close). Every
+// puzzle is given once and the source is never given, it is checked by
+// 64-bit hashes of clues, not by canonical forms (all puzzles have canonical
+// form of the source).
+class Amplifier {
+public:
+  struct RatedPuzzle {
+    Puzzle puzzle;
+    // rating of the source, not of this puzzle
+    HumanSolver::Result approximate_result;
+  };
+
+private:
+  std::string clues;
+  HumanSolver::Result result;
+  Utility::CounterRng rng;
+  std::unordered_set<uint64_t> given;
+
+public:
+  Amplifier(Puzzle puzzle, const HumanSolver::Result &result,
+            uint64_t seed = 0)
+      : clues{puzzle.clues_as_string()}, result{result}, rng{seed} {
+    given.insert(Utility::hash64(clues.data(), clues.size()));
+  }
+
+  // Returns false if max_tries transformations in a row gave puzzles, that
+  // were already given (puzzle has few different equivalents).
+  bool next(Puzzle &puzzle, size_t max_tries = 64) {
+    char transformed[81];
+    for (size_t i = 0; i < max_tries; i++) {
+      Transformation::random(rng).apply(clues.data(), transformed);
+      if (given.insert(Utility::hash64(transformed, 81)).second) {
+        return puzzle.load(std::string_view(transformed, 81));
+      }
+    }
+    return false;
+  }
+  // up to count puzzles, less if puzzle has few different equivalents
+  std::vector<RatedPuzzle> amplify(size_t count) {
+    std::vector<RatedPuzzle> res;
+    Puzzle puzzle;
+    while (res.size() < count && next(puzzle)) {
+      res.push_back({puzzle, result});
+    }
+    return res;
+  }
+  // rating of the source
+  const HumanSolver::Result &get_source_result() const { return result; }
+};
+
+// Grid with boxes of BoxRows rows and BoxCols cols (side is BoxRows *
+// BoxCols). Houses are cols, rows and boxes, in this order, like
+// Tables::houses for 9x9. Boxes are numbered left to right, top to bottom.
+template <int BoxRows, int BoxCols> struct Layout {
+  static constexpr int size = BoxRows * BoxCols;
+  static constexpr int cells = size * size;
+  static constexpr int house_count = size * 3;
+  static constexpr int peer_count = 3 * size - BoxRows - BoxCols - 1;
+  // bit (digit - 1) is set if digit is a candidate
+  using Mask = std::conditional_t<(size <= 16), uint16_t, uint32_t>;
+  static constexpr Mask all_digits = Mask((uint64_t(1) << size) - 1);
+
+  static constexpr int box_of(int cell) {
+    return cell / size / BoxRows * BoxRows + cell % size / BoxCols;
+  }
+
+  static constexpr std::array<std::array<uint16_t, size>, house_count>
+      houses = [] {
+        std::array<std::array<uint16_t, size>, house_count> res{};
+        for (int house = 0; house < size; house++) {
+          for (int i = 0; i < size; i++) {
+            // col, row
+            res[house][i] = i * size + house;
+            res[size + house][i] = house * size + i;
+            // box
+            int row = house / BoxRows * BoxRows + i / BoxCols;
+            int col = house % BoxRows * BoxCols + i % BoxCols;
+            res[2 * size + house][i] = row * size + col;
+          }
+        }
+        return res;
+      }();
+
+  static constexpr std::array<std::array<uint16_t, 3>, cells> houses_of = [] {
+    std::array<std::array<uint16_t, 3>, cells> res{};
+    for (int cell = 0; cell < cells; cell++) {
+      res[cell] = {uint16_t(cell % size), uint16_t(size + cell / size),
+                   uint16_t(2 * size + box_of(cell))};
+    }
+    return res;
+  }();
+
+  static constexpr std::array<std::array<uint16_t, peer_count>, cells> peers =
+      [] {
+        std::array<std::array<uint16_t, peer_count>, cells> res{};
+        for (int cell = 0; cell < cells; cell++) {
+          int count = 0;
+          for (int i = 0; i < size; i++) {
+            // col and row
+            int in_col = i * size + cell % size;
+            int in_row = cell / size * size + i;
+            if (in_col != cell) {
+              res[cell][count++] = in_col;
+            }
+            if (in_row != cell) {
+              res[cell][count++] = in_row;
+            }
+          }
+          // rest of the box
+          for (int other : houses[2 * size + box_of(cell)]) {
+            if (other % size != cell % size && other / size != cell / size) {
+              res[cell][count++] = other;
+            }
+          }
+        }
+        return res;
+      }();
+};
+
+// Rules of variant puzzles: extra houses (diagonals, windows or any cells
+// without repeated digits), jigsaw regions instead of boxes and killer cages.
+// Rules are compiled once into houses (lists and bitsets of cells), peers of
+// every cell and tables of digit combinations of cages, puzzles and solvers
+// only read them. Rules are added by functions or by spec, one rule per line
+// (or ';'), cells are numbers from 0:
+//   diagonals
+//   regions 111222333111222333...   cells with the same char are one region
+//   house 0 10 20 30                 extra house
+//   cage 15 0 1 9                    sum and cells
+template <int BoxRows, int BoxCols> class Variant {
+public:
+  using Layout = Sudoku::Layout<BoxRows, BoxCols>;
+  using Mask = typename Layout::Mask;
+  using Cells = std::bitset<Layout::cells>;
+  static constexpr int size = Layout::size;
+  static constexpr int cells = Layout::cells;
+
+  struct Cage {
+    int sum;
+    std::vector<int> cells;
+    // index of combinations of digits in tables
+    int table;
+  };
+
+private:
+  // regions instead of boxes, empty for boxes
+  std::vector<std::vector<int>> regions;
+  std::vector<std::vector<int>> extra_houses;
+  std::vector<Cage> cages;
+
+  // cols, rows, regions, extra houses and cages, in this order
+  std::vector<std::vector<int>> houses;
+  std::vector<Cells> house_cells;
+  std::vector<std::vector<int>> houses_of, peers;
+  std::vector<int> cage_of;
+  // tables[i] has sets of digits (as masks) of one cage size and sum
+  std::vector<std::vector<Mask>> tables;
+  std::map<std::pair<int, int>, int> table_of;
+  // why the last rejected rule is wrong
+  std::string error;
+
+  static Mask bit(int digit) { return Mask(1u << (digit - 1)); }
+
+  static void add_combinations(std::vector<Mask> &res, int count, int sum,
+                               int digit, Mask mask) {
+    if (count == 0) {
+      if (sum == 0) {
+        res.push_back(mask);
+      }
+      return;
+    }
+    for (; digit <= size && digit * count <= sum; digit++) {
+      add_combinations(res, count - 1, sum - digit, digit + 1,
+                       mask | bit(digit));
+    }
+  }
+
+  bool are_right_cells(const std::vector<int> &cells_of_rule) {
+    Cells seen;
+    for (int cell : cells_of_rule) {
+      if (cell < 0 || cell >= cells || seen[cell]) {
+        error = "wrong cell " + std::to_string(cell);
+        return false;
+      }
+      seen[cell] = true;
+    }
+    if (cells_of_rule.empty() || int(cells_of_rule.size()) > size) {
+      error = "rule has " + std::to_string(cells_of_rule.size()) + " cells";
+      return false;
+    }
+    return true;
+  }
+
+  void compile() {
+    houses.clear();
+    for (int house = 0; house < 2 * size; house++) {
+      houses.emplace_back(Layout::houses[house].begin(),
+                          Layout::houses[house].end());
+    }
+    if (regions.empty()) {
+      for (int box = 0; box < size; box++) {
+        houses.emplace_back(Layout::houses[2 * size + box].begin(),
+                            Layout::houses[2 * size + box].end());
+      }
+    } else {
+      houses.insert(houses.end(), regions.begin(), regions.end());
+    }
+    houses.insert(houses.end(), extra_houses.begin(), extra_houses.end());
+    cage_of.assign(cells, -1);
+    for (size_t cage = 0; cage < cages.size(); cage++) {
+      houses.push_back(cages[cage].cells);
+      for (int cell : cages[cage].cells) {
+        cage_of[cell] = cage;
+      }
+    }
+
+    house_cells.assign(houses.size(), Cells());
+    houses_of.assign(cells, {});
+    for (size_t house = 0; house < houses.size(); house++) {
+      for (int cell : houses[house]) {
+        house_cells[house][cell] = true;
+        houses_of[cell].push_back(house);
+      }
+    }
+    peers.assign(cells, {});
+    for (int cell = 0; cell < cells; cell++) {
+      Cells seen;
+      for (int house : houses_of[cell]) {
+        seen |= house_cells[house];
+      }
+      seen[cell] = false;
+      for (int peer = 0; peer < cells; peer++) {
+        if (seen[peer]) {
+          peers[cell].push_back(peer);
+        }
+      }
+    }
+  }
+
+public:
+  Variant() { compile(); }
+
+  // Functions, that add rules, never print: they return false for a wrong
+  // rule, then the rule is not added and get_error tells why.
+  const std::string &get_error() const { return error; }
+
+  bool add_house(const std::vector<int> &house) {
+    if (!are_right_cells(house)) {
+      return false;
+    }
+    extra_houses.push_back(house);
+    compile();
+    return true;
+  }
+  bool add_diagonals() {
+    std::vector<int> main_diagonal, anti_diagonal;
+    for (int i = 0; i < size; i++) {
+      main_diagonal.push_back(i * size + i);
+      anti_diagonal.push_back(i * size + size - 1 - i);
+    }
+    extra_houses.push_back(main_diagonal);
+    extra_houses.push_back(anti_diagonal);
+    compile();
+    return true;
+  }
+  // one char per cell, cells with the same char are one region
+  bool set_regions(std::string_view cells_regions) {
+    if (cells_regions.size() != size_t(cells)) {
+      error = "regions size (" + std::to_string(cells_regions.size()) +
+              ") != " + std::to_string(cells);
+      return false;
+    }
+    std::map<char, std::vector<int>> cells_of;
+    for (int cell = 0; cell < cells; cell++) {
+      cells_of[cells_regions[cell]].push_back(cell);
+    }
+    std::vector<std::vector<int>> new_regions;
+    for (const auto &region : cells_of) {
+      if (int(region.second.size()) != size) {
+        error = "region '" + std::string(1, region.first) + "' has " +
+                std::to_string(region.second.size()) + " cells";
+        return false;
+      }
+      new_regions.push_back(region.second);
+    }
+    regions = new_regions;
+    compile();
+    return true;
+  }
+  // cells of cages don't overlap, digits in cage are not repeated
+  bool add_cage(int sum, const std::vector<int> &cage_cells) {
+    if (!are_right_cells(cage_cells)) {
+      return false;
+    }
+    for (int cell : cage_cells) {
+      if (cage_of[cell] != -1) {
+        error = "cell " + std::to_string(cell) + " is already in cage";
+        return false;
+      }
+    }
+    std::pair<int, int> key = {cage_cells.size(), sum};
+    if (table_of.count(key) == 0) {
+      std::vector<Mask> table;
+      add_combinations(table, cage_cells.size(), sum, 1, 0);
+      if (table.empty()) {
+        error = "cage of " + std::to_string(cage_cells.size()) +
+                " cells can't have sum " + std::to_string(sum);
+        return false;
+      }
+      table_of[key] = tables.size();
+      tables.push_back(table);
+    }
+    cages.push_back({sum, cage_cells, table_of[key]});
+    compile();
+    return true;
+  }
+  // Rules are added until the first wrong one, then returns false and
+  // get_error tells what is wrong.
+  bool parse(std::string_view spec) {
+    std::string line;
+    for (size_t i = 0; i <= spec.size(); i++) {
+      if (i < spec.size() && spec[i] != '\n' && spec[i] != ';') {
+        line.push_back(spec[i]);
+        continue;
+      }
+      std::istringstream in(line);
+      std::string rule;
+      line.clear();
+      if (!(in >> rule)) {
+        continue;
+      }
+      std::vector<int> numbers;
+      std::string regions_chars;
+      bool is_parsed = true;
+      error.clear();
+      if (rule == "regions") {
+        is_parsed = bool(in >> regions_chars) && set_regions(regions_chars);
+      } else {
+        for (int number; in >> number;) {
+          numbers.push_back(number);
+        }
+        if (!in.eof()) {
+          is_parsed = false;
+        } else if (rule == "diagonals") {
+          is_parsed = numbers.empty() && add_diagonals();
+        } else if (rule == "house") {
+          is_parsed = add_house(numbers);
+        } else if (rule == "cage") {
+          is_parsed = !numbers.empty() &&
+                     add_cage(numbers[0], std::vector<int>(numbers.begin() + 1,
+                                                           numbers.end()));
+        } else {
+          is_parsed = false;
+        }
+      }
+      if (!is_parsed) {
+        error = "wrong rule \"" + in.str() + "\"" +
+                (error.empty() ? "" : ": " + error);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const std::vector<std::vector<int>> &get_houses() const { return houses; }
+  // houses without cages, for DlxSolver (it doesn't know sums)
+  std::vector<std::vector<int>> get_houses_without_cages() const {
+    return {houses.begin(), houses.end() - cages.size()};
+  }
+  const Cells &get_house_cells(int house) const { return house_cells[house]; }
+  const std::vector<int> &get_houses_of(int cell) const {
+    return houses_of[cell];
+  }
+  const std::vector<int> &get_peers(int cell) const { return peers[cell]; }
+  const std::vector<Cage> &get_cages() const { return cages; }
+  // -1 if cell is not in cage
+  int get_cage_of(int cell) const { return cage_of[cell]; }
+  int get_cage_house(int cage) const {
+    return houses.size() - cages.size() + cage;
+  }
+  const std::vector<Mask> &get_combinations(int cage) const {
+    return tables[cages[cage].table];
+  }
+
+  // digits, that can be in empty cells of cage, when placed digits are in
+  // cage and empty cells of cage can have only digits of free
+  Mask cage_digits(int cage, Mask placed,
+                   Mask free = Layout::all_digits) const {
+    Mask res = 0;
+    for (Mask combination : get_combinations(cage)) {
+      if ((combination & placed) == placed &&
+          (combination & ~placed & ~free) == 0) {
+        res |= combination;
+      }
+    }
+    return res & ~placed;
+  }
+
+  // no digit is repeated in any house, digits of cages can make their sums
+  bool is_right(const std::array<uint8_t, cells> &values) const {
+    for (const std::vector<int> &house : houses) {
+      uint32_t seen = 0;
+      for (int cell : house) {
+        if (values[cell] != 0) {
+          if (seen & (1u << values[cell])) {
+            return false;
+          }
+          seen |= 1u << values[cell];
+        }
+      }
+    }
+    for (size_t cage = 0; cage < cages.size(); cage++) {
+      Mask placed = 0;
+      for (int cell : cages[cage].cells) {
+        if (values[cell] != 0) {
+          placed |= bit(values[cell]);
+        }
+      }
+      const std::vector<Mask> &combinations = get_combinations(cage);
+      if (std::none_of(combinations.begin(), combinations.end(),
+                       [&](Mask combination) {
+                         return (combination & placed) == placed;
+                       })) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Puzzle of any size. Digits are written as 1-9 and then A, B, C, ... (so
+// 16x16 uses 1-9 and A-G), empty cells are '0' or '.'. Candidates are kept up
+// to date by set. Puzzle with variant uses its houses, peers and cages
+// instead of Layout ones, variant must live longer than puzzle.
+template <int BoxRows, int BoxCols> class BasicPuzzle {
+public:
+  using Layout = Sudoku::Layout<BoxRows, BoxCols>;
+  using Variant = Sudoku::Variant<BoxRows, BoxCols>;
+  using Mask = typename Layout::Mask;
+  static constexpr int size = Layout::size;
+  static constexpr int cells = Layout::cells;
+
+private:
+  std::array<uint8_t, cells> values{};
+  std::array<Mask, cells> candidates{};
+  const Variant *variant = nullptr;
+
+  // removes digits, that can't make sum of cage, from empty cells of cage
+  void restrict_cage(int cage) {
+    const std::vector<int> &cage_cells = variant->get_cages()[cage].cells;
+    Mask placed = 0, free = 0;
+    for (int cell : cage_cells) {
+      if (values[cell] != 0) {
+        placed |= Mask(1u << (values[cell] - 1));
+      }
+      free |= candidates[cell];
+    }
+    Mask digits = variant->cage_digits(cage, placed, free);
+    for (int cell : cage_cells) {
+      candidates[cell] &= digits;
+    }
+  }
+
+public:
+  static char to_char(int digit) {
+    return digit == 0 ? '0' : digit <= 9 ? '0' + digit : 'A' + digit - 10;
+  }
+  // -1 if c is not a digit of this size
+  static int from_char(char c) {
+    int digit = c == '.' ? 0
+                : (c >= '0' && c <= '9') ? c - '0'
+                : (c >= 'A' && c <= 'Z') ? c - 'A' + 10
+                : (c >= 'a' && c <= 'z') ? c - 'a' + 10
+                                         : -1;
+    return digit <= size ? digit : -1;
+  }
+
+  BasicPuzzle() { generate_candidates(); }
+  explicit BasicPuzzle(const Variant *variant) : variant{variant} {
+    generate_candidates();
+  }
+  BasicPuzzle(std::string_view puzzle, const Variant *variant = nullptr)
+      : variant{variant} {
+    load(puzzle);
+  }
+  bool load(std::string_view from) {
+    if (from.size() != size_t(cells)) {
+      std::cout << "Puzzle size (" << from.size() << ") != " << cells
+                << "\nPuzzle: " << from << std::endl;
+      return false;
+    }
+    for (int cell = 0; cell < cells; cell++) {
+      int digit = from_char(from[cell]);
+      if (digit < 0) {
+        std::cout << "Wrong digit '" << from[cell] << "'. Puzzle: " << from
+                  << std::endl;
+        return false;
+      }
+      values[cell] = digit;
+    }
+    generate_candidates();
+    if (!is_right()) {
+      std::cout << "Puzzle is not right. Puzzle: " << from << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  void generate_candidates() {
+    for (int cell = 0; cell < cells; cell++) {
+      candidates[cell] = values[cell] == 0 ? Layout::all_digits : 0;
+    }
+    for (int cell = 0; cell < cells; cell++) {
+      if (values[cell] == 0) {
+        continue;
+      }
+      if (variant == nullptr) {
+        for (int peer : Layout::peers[cell]) {
+          candidates[peer] &= ~Mask(1u << (values[cell] - 1));
+        }
+      } else {
+        for (int peer : variant->get_peers(cell)) {
+          candidates[peer] &= ~Mask(1u << (values[cell] - 1));
+        }
+      }
+    }
+    if (variant != nullptr) {
+      for (size_t cage = 0; cage < variant->get_cages().size(); cage++) {
+        restrict_cage(cage);
+      }
+    }
+  }
+  // digit is 0 for empty cell, candidates of peers are removed
+  void set(int cell, int digit) {
+    values[cell] = digit;
+    if (digit == 0) {
+      generate_candidates();
+      return;
+    }
+    candidates[cell] = 0;
+    if (variant == nullptr) {
+      for (int peer : Layout::peers[cell]) {
+        candidates[peer] &= ~Mask(1u << (digit - 1));
+      }
+      return;
+    }
+    for (int peer : variant->get_peers(cell)) {
+      candidates[peer] &= ~Mask(1u << (digit - 1));
+    }
+    if (variant->get_cage_of(cell) != -1) {
+      restrict_cage(variant->get_cage_of(cell));
+    }
+  }
+  const Variant *get_variant() const { return variant; }
+  // candidates are generated again
+  void set_variant(const Variant *new_variant) {
+    variant = new_variant;
+    generate_candidates();
+  }
+  int get(int cell) const { return values[cell]; }
+  Mask get_candidates(int cell) const { return candidates[cell]; }
+  void remove_candidates(int cell, Mask mask) { candidates[cell] &= ~mask; }
+
+  // no digit is repeated in any house (and sums of cages can be made)
+  bool is_right() const {
+    if (variant != nullptr) {
+      return variant->is_right(values);
+    }
+    for (const auto &house : Layout::houses) {
+      uint32_t seen = 0;
+      for (int cell : house) {
+        if (values[cell] != 0) {
+          if (seen & (1u << values[cell])) {
+            return false;
+          }
+          seen |= 1u << values[cell];
+        }
+      }
+    }
+    return true;
+  }
+  bool is_solved() const {
+    return is_right() &&
+           std::find(values.begin(), values.end(), 0) == values.end();
+  }
+  std::string clues_as_string() const {
+    std::string res;
+    for (uint8_t value : values) {
+      res.push_back(to_char(value));
+    }
+    return res;
+  }
+  void print_clues() const {
+    for (int cell = 0; cell < cells; cell++) {
+      std::cout << to_char(values[cell]);
+      if (cell % size == size - 1) {
+        std::cout << std::endl;
+      }
+    }
+  }
+};
 
-        if (!puzzle.remove_pencilmarks(positions_to_blacklist, clue)) {
-          continue;
-        }
+// Common interface of solvers of puzzles of one size. Solvers keep state
+// between calls, so every thread needs its own solver.
+template <int BoxRows, int BoxCols> class BasicSolver {
+public:
+  using Puzzle = BasicPuzzle<BoxRows, BoxCols>;
 
-        std::cout << "candidate line (" << clue
-                  << ") spotted at: " << numbers_position[0] << " and "
-                  << numbers_position[1] << std::endl;
+  virtual ~BasicSolver() = default;
+  virtual size_t count_solutions(const Puzzle &puzzle, size_t limit = 99) = 0;
+  // returns false if puzzle has no solution
+  virtual bool solve(const Puzzle &puzzle, Puzzle &solved) = 0;
+  bool has_unique_solution(const Puzzle &puzzle) {
+    return count_solutions(puzzle, 2) == 1;
+  }
+};
+
+// Backtracking solver for any size, tries cell with the fewest candidates
+// first. Solves variants (with killer cages) of puzzles too. For 9x9 TdokuLib
+// is much faster.
+template <int BoxRows, int BoxCols>
+class BasicBacktrackingSolver : public BasicSolver<BoxRows, BoxCols> {
+public:
+  using Puzzle = BasicPuzzle<BoxRows, BoxCols>;
+  using Layout = typename Puzzle::Layout;
+  using Mask = typename Layout::Mask;
+
+private:
+  static constexpr int size = Layout::size;
+  std::array<uint8_t, Layout::cells> values;
+  // used[house] has bits of digits, that are already in house
+  std::vector<Mask> used;
+  std::array<uint8_t, Layout::cells> solution;
+  size_t solutions = 0, limit = 0;
+  // variant of the puzzle, that is solved now
+  const typename Puzzle::Variant *variant = nullptr;
 
+  Mask free_digits(int cell) const {
+    if (variant == nullptr) {
+      const auto &houses = Layout::houses_of[cell];
+      return ~(used[houses[0]] | used[houses[1]] | used[houses[2]]) &
+             Layout::all_digits;
+    }
+    Mask res = Layout::all_digits;
+    for (int house : variant->get_houses_of(cell)) {
+      res &= ~used[house];
+    }
+    int cage = variant->get_cage_of(cell);
+    if (cage != -1) {
+      res &= variant->cage_digits(cage, used[variant->get_cage_house(cage)]);
+    }
+    return res;
+  }
+  void place(int cell, int digit) {
+    values[cell] = digit;
+    if (variant == nullptr) {
+      for (int house : Layout::houses_of[cell]) {
+        used[house] ^= Mask(1u << (digit - 1));
+      }
+      return;
+    }
+    for (int house : variant->get_houses_of(cell)) {
+      used[house] ^= Mask(1u << (digit - 1));
+    }
+  }
+  // returns true when limit is reached
+  bool search() {
+    int best_cell = -1, best_count = size + 1;
+    for (int cell = 0; cell < Layout::cells; cell++) {
+      if (values[cell] == 0) {
+        int count = __builtin_popcount(free_digits(cell));
+        if (count < best_count) {
+          best_cell = cell;
+          best_count = count;
+          if (count <= 1) {
+            break;
+          }
+        }
+      }
+    }
+    if (best_cell == -1) {
+      if (solutions++ == 0) {
+        solution = values;
+      }
+      return solutions >= limit;
+    }
+    for (Mask digits = free_digits(best_cell); digits != 0;
+         digits &= digits - 1) {
+      int digit = __builtin_ctz(digits) + 1;
+      place(best_cell, digit);
+      bool is_done = search();
+      place(best_cell, digit);
+      values[best_cell] = 0;
+      if (is_done) {
         return true;
       }
     }
     return false;
   }
-  struct OccupiedColsAndRows {
-    // cols_and_rows[0] - cols
-    // cols_and_rows[1] - rows
-    std::vector<int> cols_and_rows[2];
-    int number;
-  };
-  std::vector<OccupiedColsAndRows>
-  candidates_for_dpt_or_mlt(Figure &figure,
-                            std::vector<int> pencilmarks_candidates) {
-    std::vector<OccupiedColsAndRows> res;
+  bool load(const Puzzle &puzzle) {
+    variant = puzzle.get_variant();
+    used.assign(variant == nullptr ? Layout::house_count
+                                   : variant->get_houses().size(),
+                0);
+    for (int cell = 0; cell < Layout::cells; cell++) {
+      values[cell] = puzzle.get(cell);
+      if (values[cell] != 0) {
+        place(cell, values[cell]);
+      }
+    }
+    return puzzle.is_right();
+  }
 
-    for (int pencilmark : pencilmarks_candidates) {
-      Figure pencilmarks_position =
-          puzzle.get_pencilmark_positions(figure, pencilmark);
+public:
+  size_t count_solutions(const Puzzle &puzzle, size_t limit = 99) override {
+    solutions = 0;
+    this->limit = limit;
+    if (load(puzzle)) {
+      search();
+    }
+    return solutions;
+  }
+  bool solve(const Puzzle &puzzle, Puzzle &solved) override {
+    if (count_solutions(puzzle, 1) == 0) {
+      return false;
+    }
+    solved = Puzzle(puzzle.get_variant());
+    for (int cell = 0; cell < Layout::cells; cell++) {
+      solved.set(cell, solution[cell]);
+    }
+    return true;
+  }
+};
 
-      OccupiedColsAndRows to_push;
-      to_push.number = pencilmark;
-      std::vector<int> cols_occupied;
-      std::vector<int> rows_occupied;
+// Dancing links (Algorithm X) solver. Houses are set once, for example
+// Layout houses with diagonals for X-sudoku or rows, cols and regions for
+// jigsaw (Variant::get_houses_without_cages). Every digit is exactly once in
+// house of size cells and at most once in smaller house. Sums of killer cages
+// are not checked, BasicBacktrackingSolver does it. Matrix is built in
+// constructor, solving only covers rows of clues and doesn't allocate memory.
+template <int BoxRows, int BoxCols>
+class DlxSolver : public BasicSolver<BoxRows, BoxCols> {
+public:
+  using Puzzle = BasicPuzzle<BoxRows, BoxCols>;
+  using Layout = typename Puzzle::Layout;
 
-      {
-        std::set<int> cols_occupied_set =
-            pencilmarks_position.get_cols_occupied();
-        cols_occupied = std::vector<int>(cols_occupied_set.begin(),
-                                         cols_occupied_set.end());
+  static std::vector<std::vector<int>> layout_houses() {
+    std::vector<std::vector<int>> res;
+    for (const auto &house : Layout::houses) {
+      res.emplace_back(house.begin(), house.end());
+    }
+    return res;
+  }
 
-        std::set<int> rows_occupied_set =
-            pencilmarks_position.get_rows_occupied();
-        rows_occupied = std::vector<int>(rows_occupied_set.begin(),
-                                         rows_occupied_set.end());
-      }
+private:
+  static constexpr int size = Layout::size;
+  static constexpr int cells = Layout::cells;
+  // Nodes. Node 0 is the root, nodes 1 .. columns are headers of columns,
+  // column c - 1 is "cell c is filled" for c < cells and "digit d is in
+  // house h" for the rest.
+  std::vector<int> left, right, up, down, column;
+  // number of nodes in column
+  std::vector<int> column_size;
+  std::vector<bool> is_covered;
+  // first node of row cell * size + digit - 1
+  std::vector<int> row_start;
+  std::vector<int> row_of_node;
+  // chosen rows
+  std::vector<int> stack, solution;
+  size_t solutions = 0, limit = 0;
 
-      if (cols_occupied.size() == 2) {
-        to_push.cols_and_rows[0] = cols_occupied;
+  int add_node(int col) {
+    int node = left.size();
+    left.push_back(node);
+    right.push_back(node);
+    column.push_back(col);
+    up.push_back(up[col]);
+    down.push_back(col);
+    down[up[col]] = node;
+    up[col] = node;
+    column_size[col]++;
+    return node;
+  }
+
+  void cover(int col) {
+    is_covered[col] = true;
+    right[left[col]] = right[col];
+    left[right[col]] = left[col];
+    for (int row = down[col]; row != col; row = down[row]) {
+      for (int node = right[row]; node != row; node = right[node]) {
+        up[down[node]] = up[node];
+        down[up[node]] = down[node];
+        column_size[column[node]]--;
       }
-      if (rows_occupied.size() == 2) {
-        to_push.cols_and_rows[1] = rows_occupied;
+    }
+  }
+  void uncover(int col) {
+    for (int row = up[col]; row != col; row = up[row]) {
+      for (int node = left[row]; node != row; node = left[node]) {
+        column_size[column[node]]++;
+        up[down[node]] = node;
+        down[up[node]] = node;
       }
-      res.push_back(to_push);
     }
-    return res;
-  };
-  bool double_pairs_or_multiple_lines_spot(bool double_pairs) {
-    std::map<int, std::vector<OccupiedColsAndRows>> candidates;
+    right[left[col]] = col;
+    left[right[col]] = col;
+    is_covered[col] = false;
+  }
 
-    for (int square_number = 0; square_number < 9; square_number++) {
-      Figure square = Figure().square(square_number);
-      std::vector<int> pencilmarks;
-      if (double_pairs) {
-        pencilmarks = puzzle.pencilmarks_with_count(square, 2, 2);
-      } else {
-        pencilmarks = puzzle.pencilmarks_with_count(square, 2, 6);
+  // returns true when limit is reached
+  bool search(size_t depth) {
+    if (right[0] == 0) {
+      if (solutions++ == 0) {
+        solution.assign(stack.begin(), stack.begin() + depth);
       }
-      candidates[square_number] =
-          candidates_for_dpt_or_mlt(square, pencilmarks);
+      return solutions >= limit;
     }
-
-    auto print_founded = [double_pairs](OccupiedColsAndRows candidate,
-                                        int square_number1,
-                                        int square_number2) {
-      if (double_pairs) {
-        std::cout << "double pairs";
-      } else {
-        std::cout << "multiply lines";
+    int best = right[0];
+    for (int col = right[0]; col != 0; col = right[col]) {
+      if (column_size[col] < column_size[best]) {
+        best = col;
       }
-      std::cout << " (" << candidate.number
-                << ") spotted in squares: " << square_number1 << " and "
-                << square_number2 << std::endl;
-    };
-
-    auto next_square_in_col = [](int square1, int square2) {
-      int square_col = square1 % 3;
-      while (square1 == square_col || square2 == square_col) {
-        square_col += 3;
+    }
+    if (column_size[best] == 0) {
+      return false;
+    }
+    cover(best);
+    bool is_done = false;
+    for (int row = down[best]; row != best && !is_done; row = down[row]) {
+      stack[depth] = row_of_node[row];
+      for (int node = right[row]; node != row; node = right[node]) {
+        cover(column[node]);
       }
-      return square_col;
-    };
-
-    auto next_square_in_row = [](int square1, int square2) {
-      int square_row = (square1 / 3) * 3;
-      while (square1 == square_row || square2 == square_row) {
-        square_row += 1;
+      is_done = search(depth + 1);
+      for (int node = left[row]; node != row; node = left[node]) {
+        uncover(column[node]);
       }
-      return square_row;
-    };
+    }
+    uncover(best);
+    return is_done;
+  }
 
-    auto check = [this, next_square_in_row, next_square_in_col,
-                  print_founded](OccupiedColsAndRows c1, OccupiedColsAndRows c2,
-                                 int square1, int square2) {
-      if (c1.number != c2.number) {
-        return false;
+public:
+  DlxSolver(const std::vector<std::vector<int>> &houses = layout_houses()) {
+    int columns = cells + houses.size() * size;
+    column_size.assign(columns + 1, 0);
+    is_covered.assign(columns + 1, false);
+    // root and headers, houses smaller than size are not in list of headers,
+    // so they are never chosen
+    for (int col = 0; col <= columns; col++) {
+      left.push_back(col);
+      right.push_back(col);
+      up.push_back(col);
+      down.push_back(col);
+      column.push_back(col);
+    }
+    auto link_header = [&](int col) {
+      left[col] = left[0];
+      right[col] = 0;
+      right[left[0]] = col;
+      left[0] = col;
+    };
+    for (int col = 1; col <= cells; col++) {
+      link_header(col);
+    }
+    std::vector<std::vector<int>> houses_of(cells);
+    for (size_t house = 0; house < houses.size(); house++) {
+      for (int cell : houses[house]) {
+        houses_of[cell].push_back(house);
       }
-
-      // i=0 - checking cols
-      // i=1 - checking rows
-      for (int i = 0; i < 2; i++) {
-        if (c1.cols_and_rows[i] == c2.cols_and_rows[i] &&
-            c1.cols_and_rows[i].size() != 0) {
-          Figure cols_or_rows;
-          Figure figure_to_remove_from;
-          if (i == 0) {
-            cols_or_rows = Figure()
-                               .col(c1.cols_and_rows[i][0])
-                               .col(c1.cols_and_rows[i][1]);
-            figure_to_remove_from =
-                Figure().square(next_square_in_col(square1, square2));
-          } else {
-            cols_or_rows = Figure()
-                               .row(c1.cols_and_rows[i][0])
-                               .row(c1.cols_and_rows[i][1]);
-            figure_to_remove_from =
-                Figure().square(next_square_in_row(square1, square2));
-          }
-
-          figure_to_remove_from =
-              Figure::intersect(figure_to_remove_from, cols_or_rows);
-
-          if (!puzzle.remove_pencilmarks(figure_to_remove_from, c1.number)) {
-            continue;
-          }
-          print_founded(c1, square1, square2);
-          return true;
+      if (int(houses[house].size()) == size) {
+        for (int digit = 0; digit < size; digit++) {
+          link_header(1 + cells + house * size + digit);
         }
       }
-      return false;
-    };
-
-    // TODO: optimize that loop
-    for (int square_number1 = 0; square_number1 < 8; square_number1++) {
-      for (OccupiedColsAndRows candidate1 : candidates[square_number1]) {
-
-        for (int square_number2 = square_number1 + 1; square_number2 < 9;
-             square_number2++) {
-          for (OccupiedColsAndRows candidate2 : candidates[square_number2]) {
-
-            if (check(candidate1, candidate2, square_number1, square_number2)) {
-              return true;
-            }
+    }
+    row_start.resize(cells * size);
+    for (int cell = 0; cell < cells; cell++) {
+      for (int digit = 0; digit < size; digit++) {
+        std::vector<int> cols = {1 + cell};
+        for (int house : houses_of[cell]) {
+          cols.push_back(1 + cells + house * size + digit);
+        }
+        int first = -1;
+        for (int col : cols) {
+          int node = add_node(col);
+          if (first == -1) {
+            first = node;
+          } else {
+            left[node] = left[first];
+            right[node] = first;
+            right[left[first]] = node;
+            left[first] = node;
           }
         }
+        row_start[cell * size + digit] = first;
       }
     }
-
-    return false;
+    row_of_node.resize(left.size());
+    for (int row = 0; row < cells * size; row++) {
+      int first = row_start[row];
+      row_of_node[first] = row;
+      for (int node = right[first]; node != first; node = right[node]) {
+        row_of_node[node] = row;
+      }
+    }
+    stack.resize(cells);
+    solution.reserve(cells);
   }
-  bool naked_nth_spot(int N) {
-    auto find_in_figure = [N, this](Figure figure) {
-      Figure optimized_figure = figure;
-      std::map<Pos, std::vector<int>> pencilmarks =
-          puzzle.get_pencilmarks(optimized_figure);
 
-      for (auto pencilmark : pencilmarks) {
-        if (pencilmark.second.size() > N || pencilmark.second.size() == 0) {
-          optimized_figure.erase(pencilmark.first);
+  size_t count_solutions(const Puzzle &puzzle, size_t limit = 99) override {
+    solutions = 0;
+    this->limit = limit;
+    // covered columns of clues, to uncover them in reverse order
+    int clue_rows = 0;
+    bool is_conflict = false;
+    for (int cell = 0; cell < cells && !is_conflict; cell++) {
+      if (puzzle.get(cell) == 0) {
+        continue;
+      }
+      int row = row_start[cell * size + puzzle.get(cell) - 1];
+      for (int node = row;; node = right[node]) {
+        is_conflict |= is_covered[column[node]];
+        if (right[node] == row) {
+          break;
         }
       }
-
-      if (optimized_figure.size() < N) {
-        return false;
+      if (is_conflict) {
+        break;
       }
-      Utility::NDIncrementCount possible_pos{N, optimized_figure.size()};
-
-      while (possible_pos.increment()) {
-
-        Figure sub_figure =
-            optimized_figure.sub_figure(possible_pos.get_positions());
-
-        std::set<int> set_of_pencilmarks =
-            puzzle.get_pencilmarks_set(sub_figure);
-
-        if (set_of_pencilmarks.size() == N) {
-          bool is_pencilmarks_removed = false;
-          Figure figure_to_remove = figure;
-          figure_to_remove.remove(sub_figure);
-          for (int pencilmark : set_of_pencilmarks) {
-            if (puzzle.remove_pencilmarks(figure_to_remove, pencilmark)) {
-              is_pencilmarks_removed = true;
-            }
-          }
-          if (!is_pencilmarks_removed) {
-            continue;
-          }
-          std::cout << "naked " << N << " (";
-          for (int pencilmark : set_of_pencilmarks) {
-            std::cout << pencilmark << ", ";
-          }
-          std::cout << "\b\b) spotted at: " << sub_figure << std::endl;
-          return true;
+      for (int node = row;; node = right[node]) {
+        cover(column[node]);
+        if (right[node] == row) {
+          break;
+        }
+      }
+      stack[clue_rows++] = cell * size + puzzle.get(cell) - 1;
+    }
+    if (!is_conflict) {
+      search(clue_rows);
+    }
+    for (int i = clue_rows - 1; i >= 0; i--) {
+      int row = row_start[stack[i]];
+      for (int node = left[row];; node = left[node]) {
+        uncover(column[node]);
+        if (node == row) {
+          break;
         }
       }
+    }
+    return solutions;
+  }
+  bool solve(const Puzzle &puzzle, Puzzle &solved) override {
+    if (count_solutions(puzzle, 1) == 0) {
+      return false;
+    }
+    solved = Puzzle(puzzle.get_variant());
+    for (int row : solution) {
+      solved.set(row / size, row % size + 1);
+    }
+    return true;
+  }
+};
+
+// TdokuLib as BasicSolver of 9x9 puzzles.
+class TdokuSolver : public BasicSolver<3, 3> {
+private:
+  static void to_tdoku(const Puzzle &puzzle, char *out) {
+    for (int cell = 0; cell < 81; cell++) {
+      out[cell] = puzzle.get(cell) == 0 ? '.' : '0' + puzzle.get(cell);
+    }
+  }
+
+public:
+  size_t count_solutions(const Puzzle &puzzle, size_t limit = 99) override {
+    // tdoku writes the solution, when limit is 1
+    char cells[82] = {}, solution[81];
+    to_tdoku(puzzle, cells);
+    size_t number_of_guesses = 0;
+    return Tdoku::SolveSudoku(cells, limit, 0, solution, &number_of_guesses);
+  }
+  bool solve(const Puzzle &puzzle, Puzzle &solved) override {
+    char cells[82] = {}, solution[81];
+    to_tdoku(puzzle, cells);
+    size_t number_of_guesses = 0;
+    if (Tdoku::SolveSudoku(cells, 1, 0, solution, &number_of_guesses) == 0) {
       return false;
-    };
-    for (int figure_number = 0; figure_number < 9; figure_number++) {
-      Figure col = Figure().col(figure_number);
-      Figure row = Figure().row(figure_number);
-      Figure square = Figure().square(figure_number);
-      if (find_in_figure(col) || find_in_figure(row) ||
-          find_in_figure(square)) {
+    }
+    return solved.load(std::string_view(solution, 81));
+  }
+};
+
+// HumanSolver for any size. Knows Single Candidate, Single Position,
+// Candidate Lines and Naked Pair, scores are the ones of HumanSolver. For
+// puzzle with variant methods work in all its houses (regions instead of
+// boxes, extra houses and cages).
+template <int BoxRows, int BoxCols> class BasicHumanSolver {
+public:
+  using Puzzle = BasicPuzzle<BoxRows, BoxCols>;
+  using Layout = typename Puzzle::Layout;
+  using Variant = typename Puzzle::Variant;
+  using Mask = typename Layout::Mask;
+
+private:
+  static constexpr int size = Layout::size;
+  Puzzle puzzle;
+  std::multimap<int, std::string> methods_score = {
+      {10, "Single Candidate"},
+      {10, "Single Position"},
+      {35, "Candidate Lines"},
+      {75, "Naked Pair"},
+  };
+  std::map<std::string, int> method_scores_subsequent = {
+      {"Single Candidate", 10},
+      {"Single Position", 10},
+      {"Candidate Lines", 20},
+      {"Naked Pair", 50},
+  };
+
+  static Mask bit(int digit) { return Mask(1u << (digit - 1)); }
+
+  // calls function(house) for every house, until it returns true
+  template <class Function> bool any_house(Function function) const {
+    if (puzzle.get_variant() == nullptr) {
+      return std::any_of(Layout::houses.begin(), Layout::houses.end(),
+                         function);
+    }
+    const auto &houses = puzzle.get_variant()->get_houses();
+    return std::any_of(houses.begin(), houses.end(), function);
+  }
+
+  bool single_candidate_spot() {
+    for (int cell = 0; cell < Layout::cells; cell++) {
+      Mask candidates = puzzle.get_candidates(cell);
+      if (puzzle.get(cell) == 0 && __builtin_popcount(candidates) == 1) {
+        puzzle.set(cell, __builtin_ctz(candidates) + 1);
         return true;
       }
     }
     return false;
   }
-  bool hidden_nth_spot(int N) {
-    auto find_in_figure = [N, this](Figure figure) {
-      Figure optimized_figure = figure;
-      std::map<Pos, std::vector<int>> pencilmarks =
-          puzzle.get_pencilmarks(optimized_figure);
-
-      for (auto pencilmark : pencilmarks) {
-        // TODO: insert in Puzzle::get_pencilmarks function.
-        if (pencilmark.second.size() == 0) {
-          optimized_figure.erase(pencilmark.first);
-        }
-      }
-
-      if (optimized_figure.size() < N) {
+  bool single_position_spot() {
+    return any_house([&](const auto &house) {
+      // every digit must be only in houses of size cells
+      if (int(house.size()) != size) {
         return false;
       }
-
-      std::vector<int> set_of_pencilmarks =
-          puzzle.pencilmarks_with_count(optimized_figure, 2, N);
-
-      if (set_of_pencilmarks.size() < N) {
+      // digits, seen once and seen more than once
+      Mask once = 0, more = 0;
+      for (int cell : house) {
+        more |= once & puzzle.get_candidates(cell);
+        once |= puzzle.get_candidates(cell);
+      }
+      Mask single = once & ~more;
+      if (single == 0) {
         return false;
       }
-
-      Utility::NDIncrementCount possible_pos{N, set_of_pencilmarks.size()};
-
-      while (possible_pos.increment()) {
-        Figure sub_figure;
-        for (int i : possible_pos.get_positions()) {
-          Figure figure_to_insert =
-              puzzle.get_pencilmark_positions(figure, set_of_pencilmarks[i]);
-          sub_figure.insert(figure_to_insert.begin(), figure_to_insert.end());
+      for (int cell : house) {
+        if (puzzle.get_candidates(cell) & single & -single) {
+          puzzle.set(cell, __builtin_ctz(single) + 1);
+          return true;
         }
-
-        if (sub_figure.size() == N) {
-          std::vector<int> pencilmarks_to_left;
-          for (int i : possible_pos.get_positions()) {
-            pencilmarks_to_left.push_back(set_of_pencilmarks[i]);
+      }
+      return false;
+    });
+  }
+  // digit in region is only in cells of other house (line, diagonal, cage),
+  // so it is not in the rest of that house
+  bool variant_candidate_lines_spot() {
+    const Variant &variant = *puzzle.get_variant();
+    for (int region = 2 * size; region < 3 * size; region++) {
+      for (int digit = 1; digit <= size; digit++) {
+        typename Variant::Cells with_digit;
+        int first = -1;
+        for (int cell : variant.get_houses()[region]) {
+          if (puzzle.get_candidates(cell) & bit(digit)) {
+            with_digit[cell] = true;
+            first = first == -1 ? cell : first;
           }
-          if (!puzzle.remove_all_pencilmarks_except(sub_figure,
-                                                    pencilmarks_to_left)) {
+        }
+        if (first == -1) {
+          continue;
+        }
+        for (int house : variant.get_houses_of(first)) {
+          if (house == region ||
+              (with_digit & ~variant.get_house_cells(house)).any()) {
             continue;
           }
-          std::cout << "hidden " << N << " (";
-          for (int i : possible_pos.get_positions()) {
-            std::cout << set_of_pencilmarks[i] << ", ";
+          bool is_removed = false;
+          for (int cell : variant.get_houses()[house]) {
+            if (!variant.get_house_cells(region)[cell] &&
+                (puzzle.get_candidates(cell) & bit(digit))) {
+              puzzle.remove_candidates(cell, bit(digit));
+              is_removed = true;
+            }
+          }
+          if (is_removed) {
+            return true;
           }
-          std::cout << "\b\b) spotted at: " << sub_figure << std::endl;
-          return true;
         }
       }
-      return false;
-    };
-    for (int figure_number = 0; figure_number < 9; figure_number++) {
-      Figure col = Figure().col(figure_number);
-      Figure row = Figure().row(figure_number);
-      Figure square = Figure().square(figure_number);
-      if (find_in_figure(col) || find_in_figure(row) ||
-          find_in_figure(square)) {
-        return true;
-      }
     }
     return false;
   }
-  class XWingCandidate {
-  public:
-    bool is_row;
-    int digit;
-    Figure positions;
-    bool is_situable(XWingCandidate &other) {
-      if (is_row != other.is_row || digit != other.digit) {
-        return false;
-      }
-      if (is_row) {
-        return positions[0].col == other.positions[0].col &&
-               positions[1].col == other.positions[1].col;
-      }
-      return positions[0].row == other.positions[0].row &&
-             positions[1].row == other.positions[1].row;
+  // digit in box is only in one line, so it is not in the rest of the line
+  bool candidate_lines_spot() {
+    if (puzzle.get_variant() != nullptr) {
+      return variant_candidate_lines_spot();
     }
-  };
-  bool xwing_spot() {
-    // TODO: Optimizable. Use std::map<std::vector<XWingCandidate>>, where key
-    // is the digit
-    std::vector<XWingCandidate> candidates;
-    auto add_candidates_from_figure = [&candidates, this](Figure &f,
-                                                          bool is_row) {
-      std::vector<int> pencilmarks_with_count_2 =
-          puzzle.pencilmarks_with_count(f, 2, 2);
-      for (int pencilmark : pencilmarks_with_count_2) {
-        Figure positions = puzzle.get_pencilmark_positions(f, pencilmark);
-        candidates.push_back({});
-        candidates.back().is_row = is_row;
-        candidates.back().digit = pencilmark;
-        candidates.back().positions = positions;
-      }
-    };
-    auto founded = [this](XWingCandidate candidate, Figure positions_involved) {
-      Figure positions_to_remove_from;
-      for (Pos pos : positions_involved) {
-        Figure f;
-        if (candidate.is_row) {
-          f = Figure().col(pos.col);
-        } else {
-          f = Figure().row(pos.row);
+    for (int box = 0; box < size; box++) {
+      const auto &cells = Layout::houses[2 * size + box];
+      for (int digit = 1; digit <= size; digit++) {
+        int line_of[2] = {-1, -1};
+        bool is_one_line[2] = {true, true};
+        for (int cell : cells) {
+          if (!(puzzle.get_candidates(cell) & bit(digit))) {
+            continue;
+          }
+          for (int kind = 0; kind < 2; kind++) {
+            int line = Layout::houses_of[cell][kind];
+            if (line_of[kind] != -1 && line_of[kind] != line) {
+              is_one_line[kind] = false;
+            }
+            line_of[kind] = line;
+          }
         }
-        positions_to_remove_from.insert(f.begin(), f.end());
-      }
-      positions_to_remove_from.remove(positions_involved);
-      if (!puzzle.remove_pencilmarks(positions_to_remove_from,
-                                     candidate.digit)) {
-        return false;
-      }
-      std::cout << "x-wing (" << candidate.digit << ") found at "
-                << positions_involved << std::endl;
-      return true;
-    };
-    for (int i = 0; i < 9; i++) {
-      Figure row = Figure().row(i);
-      Figure col = Figure().col(i);
-      add_candidates_from_figure(row, true);
-      add_candidates_from_figure(col, false);
-    }
-		if (candidates.size() == 0){ return false; }
-    for (int i = 0; i < candidates.size() - 1; i++) {
-      XWingCandidate candidate1 = candidates[i];
-      for (int j = i + 1; j < candidates.size(); j++) {
-        XWingCandidate candidate2 = candidates[j];
-        if (candidate1.is_situable(candidate2)) {
-          Figure positions_involved = candidate1.positions;
-          positions_involved.insert(candidate2.positions.begin(),
-                                    candidate2.positions.end());
-          if (!founded(candidate1, positions_involved)) {
+        for (int kind = 0; kind < 2; kind++) {
+          if (line_of[kind] == -1 || !is_one_line[kind]) {
             continue;
           }
-          return true;
+          bool is_removed = false;
+          for (int cell : Layout::houses[line_of[kind]]) {
+            if (Layout::box_of(cell) != box &&
+                (puzzle.get_candidates(cell) & bit(digit))) {
+              puzzle.remove_candidates(cell, bit(digit));
+              is_removed = true;
+            }
+          }
+          if (is_removed) {
+            return true;
+          }
         }
       }
     }
     return false;
   }
-
-public:
-  class Result {
-  public:
-    int score = 0;
-    bool is_solved = false;
-    std::set<std::string> used_methods;
-    bool operator==(Result const &other) {
-      return other.score == score && other.is_solved == is_solved &&
-             other.used_methods == used_methods;
-    };
-    bool operator!=(Result const &other) { return !(*this == other); }
-    friend std::ostream &operator<<(std::ostream &os,
-                                    const Result &solver_res) {
-      os << "Score: " << solver_res.score << std::endl;
-      os << "Is solved: " << solver_res.is_solved << std::endl;
-      os << "Used methods: {";
-      for (std::string used_method : solver_res.used_methods) {
-        std::cout << "\"" << used_method << "\", ";
+  bool naked_pair_spot() {
+    return any_house([&](const auto &house) {
+      int house_size = house.size();
+      for (int i = 0; i < house_size; i++) {
+        Mask pair = puzzle.get_candidates(house[i]);
+        if (__builtin_popcount(pair) != 2) {
+          continue;
+        }
+        for (int j = i + 1; j < house_size; j++) {
+          if (puzzle.get_candidates(house[j]) != pair) {
+            continue;
+          }
+          bool is_removed = false;
+          for (int k = 0; k < house_size; k++) {
+            if (k != i && k != j &&
+                (puzzle.get_candidates(house[k]) & pair)) {
+              puzzle.remove_candidates(house[k], pair);
+              is_removed = true;
+            }
+          }
+          if (is_removed) {
+            return true;
+          }
+        }
       }
-      os << "\b\b}" << std::endl;
-      return os;
-    }
-  };
-  HumanSolver(Puzzle _puzzle) : puzzle{_puzzle} {
-		puzzle.generate_pencilmarks();
-    methods_score = {
-        {10, "Single Candidate"}, {10, "Single Position"},
-        {35, "Candidate Lines"},  {50, "Double Pairs"},
-        {70, "Multiple Lines"},   {75, "Naked Pair"},
-        {150, "Hidden Pair"},     {200, "Naked Triple"},
-        {240, "Hidden Triple"},   {280, "X-Wing"},
-        {420, "Forcing Chains"},  {500, "Naked Quad"},
-        {700, "Hidden Quad"},     {800, "Swordfish"},
-    };
-
-    method_scores_subsequent = {
-        {"Single Candidate", 10}, {"Single Position", 10},
-        {"Candidate Lines", 20},  {"Double Pairs", 25},
-        {"Multiple Lines", 40},   {"Naked Pair", 50},
-        {"Hidden Pair", 120},     {"Naked Triple", 140},
-        {"Hidden Triple", 160},   {"X-Wing", 160},
-        {"Forcing Chains", 210},  {"Naked Quad", 400},
-        {"Hidden Quad", 500},     {"Swordfish", 600},
-    };
+      return false;
+    });
   }
-  std::string solving_step(Result &res) {
+
+  std::string apply_methods() {
     for (auto method : methods_score) {
-      if (method.second == "Single Candidate" && single_candidate_spot()) {
-        return method.second;
-      } else if (method.second == "Single Position" && single_position_spot()) {
-        return method.second;
-      } else if (method.second == "Candidate Lines" && candidate_lines_spot()) {
-        return method.second;
-      } else if (method.second == "Double Pairs" &&
-                 double_pairs_or_multiple_lines_spot(true)) {
-        return method.second;
-      } else if (method.second == "Multiple Lines" &&
-                 double_pairs_or_multiple_lines_spot(false)) {
-        return method.second;
-      } else if (method.second == "Naked Pair" && naked_nth_spot(2)) {
-        return method.second;
-      } else if (method.second == "Hidden Pair" && hidden_nth_spot(2)) {
-        return method.second;
-      } else if (method.second == "Naked Triple" && naked_nth_spot(3)) {
-        return method.second;
-      } else if (method.second == "Hidden Triple" && hidden_nth_spot(3)) {
-        return method.second;
-      } else if (method.second == "Naked Quad" && naked_nth_spot(4)) {
-        return method.second;
-      } else if (method.second == "Hidden Quad" && hidden_nth_spot(4)) {
-        return method.second;
-      } else if (method.second == "X-Wing" && xwing_spot()) {
+      if ((method.second == "Single Candidate" && single_candidate_spot()) ||
+          (method.second == "Single Position" && single_position_spot()) ||
+          (method.second == "Candidate Lines" && candidate_lines_spot()) ||
+          (method.second == "Naked Pair" && naked_pair_spot())) {
         return method.second;
       }
     }
-
-    std::cout << "can't solve this puzzle!:(\n";
-    puzzle.print_clues();
-    puzzle.print_pencilmarks();
     return "";
   }
-  void update_result_and_methods(Result &res, std::string used_method) {
+  void update_result_and_methods(HumanSolver::Result &res,
+                                 const std::string &used_method) {
     res.used_methods.insert(used_method);
-    auto it_to_remove = methods_score.end();
     for (auto it = methods_score.begin(); it != methods_score.end(); it++) {
       if (it->second == used_method) {
         res.score += it->first;
         if (it->first != method_scores_subsequent[used_method]) {
-          it_to_remove = it;
+          methods_score.erase(it);
+          methods_score.emplace(method_scores_subsequent[used_method],
+                                used_method);
+        }
+        return;
+      }
+    }
+  }
+
+public:
+  BasicHumanSolver(Puzzle puzzle) : puzzle{puzzle} {}
+
+  HumanSolver::Result solve() {
+    HumanSolver::Result res = {};
+    while (!puzzle.is_solved()) {
+      std::string used_method = apply_methods();
+      if (used_method == "") {
+        return res;
+      }
+      update_result_and_methods(res, used_method);
+    }
+    res.is_solved = true;
+    return res;
+  }
+  Puzzle &get_puzzle() { return puzzle; }
+};
+
+using Puzzle4 = BasicPuzzle<2, 2>;
+using Puzzle6 = BasicPuzzle<2, 3>;
+using Puzzle16 = BasicPuzzle<4, 4>;
+using Puzzle25 = BasicPuzzle<5, 5>;
+
+// Runs tasks somewhere else. AsyncSudoku can use any executor, for example
+// the one of the event loop.
+class Executor {
+public:
+  virtual ~Executor() = default;
+  virtual void submit(std::function<void()> task) = 0;
+};
+
+// Executor with fixed number of threads. Destructor waits for all submitted
+// tasks.
+class ThreadPool : public Executor {
+private:
+  std::vector<std::thread> threads;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable has_task;
+  bool is_stopping = false;
+
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        has_task.wait(lock, [&] { return !tasks.empty() || is_stopping; });
+        if (tasks.empty()) {
+          return;
         }
-        break;
+        task = std::move(tasks.front());
+        tasks.pop_front();
       }
+      task();
     }
-    if (it_to_remove != methods_score.end()) {
-      methods_score.erase(it_to_remove);
-      methods_score.emplace(method_scores_subsequent[used_method], used_method);
+  }
+
+public:
+  ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); i++) {
+      this->threads.emplace_back([this] { work(); });
     }
   }
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      is_stopping = true;
+    }
+    has_task.notify_all();
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+  }
+  void submit(std::function<void()> task) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+    }
+    has_task.notify_one();
+  }
+};
 
-  Result solve() {
-    Result res = {};
-    std::cout << "solving: " << std::endl;
-    puzzle.print_clues();
-    while (puzzle.is_space_for_clues_avalible()) {
-      std::string used_method = solving_step(res);
-      if (used_method == "") {
-        return res;
-      };
-      update_result_and_methods(res, used_method);
+// Copies share one flag. Cancelled task gives empty optional.
+class CancellationToken {
+private:
+  std::shared_ptr<std::atomic<bool>> flag =
+      std::make_shared<std::atomic<bool>>(false);
+
+public:
+  void cancel() { *flag = true; }
+  bool is_cancelled() const { return *flag; }
+  const std::atomic<bool> *get_flag() const { return flag.get(); }
+};
+
+// Generation, solving and rating in executor, so caller never runs solver
+// code itself. Tasks, cancelled before start, are not run. Rating is also
+// stopped between steps of HumanSolver.
+class AsyncSudoku {
+private:
+  std::unique_ptr<ThreadPool> own_executor;
+  Executor *executor;
+
+  template <class T, class Function>
+  std::future<std::optional<T>> run(CancellationToken token, Function function) {
+    auto promise = std::make_shared<std::promise<std::optional<T>>>();
+    std::future<std::optional<T>> future = promise->get_future();
+    executor->submit([promise, token, function]() mutable {
+      if (token.is_cancelled()) {
+        promise->set_value(std::nullopt);
+        return;
+      }
+      // exception of the task goes to the future, not to the worker
+      try {
+        std::optional<T> res = function();
+        promise->set_value(token.is_cancelled() ? std::nullopt : res);
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+      }
+    });
+    return future;
+  }
+
+public:
+  // uses own ThreadPool
+  AsyncSudoku(size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+      : own_executor{std::make_unique<ThreadPool>(threads)},
+        executor{own_executor.get()} {}
+  // executor must outlive AsyncSudoku and all its tasks
+  AsyncSudoku(Executor &executor) : executor{&executor} {}
+
+  std::future<std::optional<Puzzle>> generate(unsigned int seed,
+                                              CancellationToken token = {}) {
+    return run<Puzzle>(token, [seed]() {
+      return std::optional<Puzzle>(Generator(seed).generate());
+    });
+  }
+  // empty optional also if puzzle has no solution
+  std::future<std::optional<Puzzle>> solve(Puzzle puzzle,
+                                           CancellationToken token = {}) {
+    return run<Puzzle>(token, [puzzle]() {
+      Puzzle solved;
+      return TdokuLib(puzzle).solve(solved) ? std::optional<Puzzle>(solved)
+                                            : std::nullopt;
+    });
+  }
+  // cache must outlive the task
+  std::future<std::optional<HumanSolver::Result>>
+  rate(Puzzle puzzle, bool is_unique = false, CancellationToken token = {},
+       StepCache *step_cache = nullptr) {
+    return run<HumanSolver::Result>(token, [puzzle, is_unique, token,
+                                            step_cache]() {
+      HumanSolver solver(puzzle, is_unique);
+      solver.set_cancel_flag(token.get_flag());
+      solver.set_step_cache(step_cache);
+      return std::optional<HumanSolver::Result>(solver.solve());
+    });
+  }
+  std::future<std::optional<bool>>
+  has_unique_solution(Puzzle puzzle, CancellationToken token = {}) {
+    return run<bool>(token, [puzzle]() {
+      return std::optional<bool>(TdokuLib(puzzle).has_unique_solution());
+    });
+  }
+};
+
+// Binary file of puzzles. Every record has the same size, so record i is read
+// without any index or parsing, and blocks of records can be decoded by
+// different threads. Record is clues (4 bits per cell), clue count and, if
+// file has them, rating and solution (4 bits per cell).
+class BinaryPuzzleFile {
+public:
+  enum Flags : uint32_t { with_rating = 1, with_solution = 2 };
+  struct Record {
+    // 81 chars, '0' for empty cell
+    std::string clues;
+    int clue_count = 0;
+    RatingCache::Record rating;
+    // empty if file has no solutions
+    std::string solution;
+  };
+
+protected:
+  struct Header {
+    char magic[8];
+    uint32_t flags;
+    uint32_t record_size;
+    uint64_t count;
+  };
+  static constexpr char magic[8] = {'S', 'D', 'K', 'P', 'U', 'Z', '0', '1'};
+  static constexpr size_t packed_grid_size = 41;
+  static constexpr size_t rating_size = 9;
+
+  static uint32_t record_size(uint32_t flags) {
+    return packed_grid_size + 1 + (flags & with_rating ? rating_size : 0) +
+           (flags & with_solution ? packed_grid_size : 0);
+  }
+  static void pack_grid(std::string_view grid, uint8_t *out) {
+    std::memset(out, 0, packed_grid_size);
+    for (int index = 0; index < 81; index++) {
+      char c = grid[index];
+      uint8_t digit = (c >= '1' && c <= '9') ? c - '0' : 0;
+      out[index / 2] |= digit << (index % 2 * 4);
     }
-    if (puzzle.is_solved()) {
-      std::cout << "solved!\nscore: " << res.score << std::endl;
+  }
+  static void unpack_grid(const uint8_t *in, char *grid) {
+    for (int index = 0; index < 81; index++) {
+      grid[index] = '0' + ((in[index / 2] >> (index % 2 * 4)) & 0xf);
     }
-    res.is_solved = true;
-    return res;
   }
-  Puzzle &get_puzzle() { return puzzle; }
 };
 
-class TdokuLib{
-	Puzzle puzzle;
-	char cstr_puzzle[82];
-	void generate_cstr(){
-		std::string clues_string = puzzle.clues_as_string();
-		std::replace(clues_string.begin(), clues_string.end(), '0', '.');
-		if (clues_string.size() != 81) {return;}
-		strncpy(cstr_puzzle, clues_string.c_str(), 81);
-		cstr_puzzle[81] = '\0';
-	}
+class BinaryPuzzleWriter : public BinaryPuzzleFile {
+private:
+  std::ofstream file;
+  Header header{};
+  std::vector<uint8_t> buffer;
+
 public:
-	TdokuLib(Puzzle puzzle){
-		load(puzzle);
-	}
-	void load(Puzzle puzzle){
-		this->puzzle = puzzle;
-		generate_cstr();
-	}
+  BinaryPuzzleWriter() = default;
+  BinaryPuzzleWriter(const std::string &path, uint32_t flags = 0) {
+    open(path, flags);
+  }
+  ~BinaryPuzzleWriter() { close(); }
 
-	int count_solutions(size_t limit = 99){
-		char solution[81];
-		size_t number_of_guesses = 0;
-		return Tdoku::SolveSudoku(cstr_puzzle, limit, 0, solution, &number_of_guesses);
-	}
+  bool open(const std::string &path, uint32_t flags = 0) {
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.flags = flags;
+    header.record_size = record_size(flags);
+    header.count = 0;
+    buffer.resize(header.record_size);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    return bool(file);
+  }
+  // Fields, that file doesn't have, are ignored.
+  bool write(const Record &record) {
+    if (!file.is_open() || record.clues.size() != 81 ||
+        (header.flags & with_solution && record.solution.size() != 81)) {
+      return false;
+    }
+    uint8_t *out = buffer.data();
+    pack_grid(record.clues, out);
+    out[packed_grid_size] = std::count_if(
+        record.clues.begin(), record.clues.end(),
+        [](char c) { return c >= '1' && c <= '9'; });
+    out += packed_grid_size + 1;
+    if (header.flags & with_rating) {
+      std::memcpy(out, &record.rating.score, 4);
+      std::memcpy(out + 4, &record.rating.methods, 4);
+      out[8] = record.rating.is_solved;
+      out += rating_size;
+    }
+    if (header.flags & with_solution) {
+      pack_grid(record.solution, out);
+    }
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    header.count++;
+    return bool(file);
+  }
+  // writes number of records to the header, returns false if any write failed
+  bool close() {
+    if (!file.is_open()) {
+      return false;
+    }
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    return bool(file);
+  }
+};
 
-	bool has_unique_solution(){
-		return count_solutions(2) == 1;
-	}
+class BinaryPuzzleReader : public BinaryPuzzleFile {
+private:
+  int fd = -1;
+  const uint8_t *data = nullptr;
+  size_t file_size = 0;
+  Header header{};
 
-	Puzzle solve(){
-		Puzzle solved;
+public:
+  BinaryPuzzleReader() = default;
+  BinaryPuzzleReader(const std::string &path) { open(path); }
+  BinaryPuzzleReader(const BinaryPuzzleReader &) = delete;
+  BinaryPuzzleReader &operator=(const BinaryPuzzleReader &) = delete;
+  ~BinaryPuzzleReader() { close(); }
 
-		char solution[81];
-		size_t number_of_guesses = 0;
+  bool open(const std::string &path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+      close();
+      return false;
+    }
+    file_size = st.st_size;
+    void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close();
+      return false;
+    }
+    data = static_cast<const uint8_t *>(mapped);
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+        header.record_size != record_size(header.flags) ||
+        sizeof(Header) + header.count * header.record_size > file_size) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  void close() {
+    if (data != nullptr) {
+      munmap(const_cast<uint8_t *>(data), file_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+    data = nullptr;
+    header = {};
+  }
+  bool is_open() const { return data != nullptr; }
 
-		Tdoku::SolveSudoku(cstr_puzzle, 1, 0, solution, &number_of_guesses);
-		
-		solved.load(std::string(solution, 81));
+  size_t size() const { return header.count; }
+  uint32_t flags() const { return header.flags; }
+  // Writes 81 chars of clues, faster than get if only clues are needed.
+  // Returns false if there is no record index.
+  bool clues(size_t index, char *out) const {
+    if (index >= size()) {
+      return false;
+    }
+    unpack_grid(data + sizeof(Header) + index * header.record_size, out);
+    return true;
+  }
+  // empty record if there is no record index
+  Record get(size_t index) const {
+    if (index >= size()) {
+      return {};
+    }
+    const uint8_t *in = data + sizeof(Header) + index * header.record_size;
+    Record record;
+    record.clues.resize(81);
+    unpack_grid(in, record.clues.data());
+    record.clue_count = in[packed_grid_size];
+    in += packed_grid_size + 1;
+    if (header.flags & with_rating) {
+      std::memcpy(&record.rating.score, in, 4);
+      std::memcpy(&record.rating.methods, in + 4, 4);
+      record.rating.is_solved = in[8];
+      in += rating_size;
+    }
+    if (header.flags & with_solution) {
+      record.solution.resize(81);
+      unpack_grid(in, record.solution.data());
+    }
+    return record;
+  }
+  // empty puzzle if there is no record index
+  Puzzle puzzle(size_t index) const {
+    char grid[81];
+    if (!clues(index, grid)) {
+      return Puzzle();
+    }
+    return Puzzle(std::string_view(grid, 81));
+  }
+  // Records [first, second) of block number index of count blocks.
+  std::pair<size_t, size_t> block(size_t index, size_t count) const {
+    return {size() * index / count, size() * (index + 1) / count};
+  }
+};
 
-		return solved;
-	}
+// Converts text file with one puzzle per line to binary file. Solutions are
+// found with TdokuLib and ratings with HumanSolver, if flags ask for them.
+// Lines, that are not valid puzzles, are skipped. Returns number of written
+// puzzles, 0 if binary file can't be written.
+inline size_t text_to_binary(const std::string &text_path,
+                             const std::string &binary_path,
+                             uint32_t flags = 0) {
+  PuzzleFile text(text_path);
+  BinaryPuzzleWriter writer;
+  if (!writer.open(binary_path, flags)) {
+    return 0;
+  }
+  size_t count = 0;
+  text.all().for_each([&](std::string_view line) {
+    Puzzle puzzle;
+    if (!puzzle.load(line)) {
+      return;
+    }
+    BinaryPuzzleFile::Record record;
+    record.clues = puzzle.clues_as_string();
+    if (flags & BinaryPuzzleFile::with_solution) {
+      record.solution = TdokuLib(puzzle).solve().clues_as_string();
+    }
+    if (flags & BinaryPuzzleFile::with_rating) {
+      HumanSolver::Result res = HumanSolver(puzzle).solve();
+      record.rating = {res.score, res.is_solved,
+                       HumanSolver::methods_to_mask(res.used_methods)};
+    }
+    count += writer.write(record);
+  });
+  return writer.close() ? count : 0;
+}
 
-	std::string minimize(){
-		char res[81];
-		strncpy(res, cstr_puzzle, 81);
-		Tdoku::TdokuMinimize(false, false, res);
-		return std::string(res, 81);
-	}
+// Writes clues of every puzzle of binary file as a line of text file.
+inline size_t binary_to_text(const std::string &binary_path,
+                             const std::string &text_path) {
+  BinaryPuzzleReader reader(binary_path);
+  std::ofstream text(text_path, std::ios::binary | std::ios::trunc);
+  char line[82];
+  line[81] = '\n';
+  for (size_t index = 0; index < reader.size(); index++) {
+    reader.clues(index, line);
+    text.write(line, 82);
+  }
+  return reader.size();
+}
+
+// Archive of puzzles, compressed in independent blocks. Puzzles are stored in
+// canonical form, sorted inside the block, so neighbours share long prefix.
+// Every puzzle is the length of the prefix, shared with the previous puzzle
+// (one byte), and the rest of cells as 4 bit codes: 1-9 is a digit, 0 is an
+// empty cell and 10 + k is 2 ^ (k + 1) empty cells. Index of blocks is at the
+// end of file, so blocks can be decoded in parallel.
+class PuzzleArchive {
+protected:
+  struct Header {
+    char magic[8];
+    uint64_t count;
+    uint64_t block_count;
+    uint64_t index_offset;
+  };
+  struct BlockInfo {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t count;
+  };
+  static constexpr char magic[8] = {'S', 'D', 'K', 'A', 'R', 'C', '0', '1'};
 };
 
-class Generator {
+class PuzzleArchiveWriter : public PuzzleArchive {
 private:
-  Puzzle puzzle;
-  std::mt19937 rg;
+  std::ofstream file;
+  Header header{};
+  std::vector<BlockInfo> index;
+  std::vector<std::string> puzzles;
+  size_t block_size = 4096;
+  bool canonicalize = true;
+  Canonicalizer canonicalizer;
+  std::vector<uint8_t> buffer;
+  bool is_high_nibble = false;
 
-  void fill_diagonals() {
-    for (int square_number = 0; square_number < 9; square_number += 4) {
-      std::vector<int> numbers;
-      numbers.resize(9);
-      std::iota(numbers.begin(), numbers.end(), 1);
-      std::shuffle(numbers.begin(), numbers.end(), rg);
-      Figure square = Figure().square(square_number);
-      for (Pos pos : square) {
-        puzzle.set_clue(pos, numbers.back());
-        numbers.pop_back();
-      }
+  void put(uint8_t nibble) {
+    if (is_high_nibble) {
+      buffer.back() |= nibble << 4;
+    } else {
+      buffer.push_back(nibble);
     }
+    is_high_nibble = !is_high_nibble;
   }
-  bool fill(Pos pos) {
-    // if we reached end of the puzzle
-    if (pos == Pos{9, 8}) {
-      return true;
+  void put_empty_cells(int count) {
+    for (int k = 5; k >= 0; k--) {
+      while (count >= 2 << k) {
+        put(10 + k);
+        count -= 2 << k;
+      }
     }
-    // if we reached end of the row
-    if (pos.col == 9) {
-      pos.row += 1;
-      pos.col = 0;
+    if (count == 1) {
+      put(0);
     }
-    if (puzzle.get_clues()[pos] != 0) {
-      pos.col += 1;
-      return fill(pos);
+  }
+  void write_block() {
+    if (puzzles.empty()) {
+      return;
     }
-    for (int num = 1; num < 10; num++) {
-      if (puzzle.is_valid_clue(pos, num)) {
-        puzzle.set_clue(pos, num);
-        Pos pos_to_fill = pos;
-        pos_to_fill.col += 1;
-        if (fill(pos_to_fill)) {
-          return true;
+    std::sort(puzzles.begin(), puzzles.end());
+    buffer.clear();
+    is_high_nibble = false;
+    std::string_view previous;
+    for (const std::string &puzzle : puzzles) {
+      int prefix = 0;
+      while (prefix < int(previous.size()) && prefix < 81 &&
+             previous[prefix] == puzzle[prefix]) {
+        prefix++;
+      }
+      put(prefix & 0xf);
+      put(prefix >> 4);
+      int empty = 0;
+      for (int index = prefix; index < 81; index++) {
+        if (puzzle[index] == '0') {
+          empty++;
+          continue;
         }
-        puzzle.set_clue(pos, 0);
+        put_empty_cells(empty);
+        empty = 0;
+        put(puzzle[index] - '0');
       }
+      put_empty_cells(empty);
+      previous = puzzle;
     }
-    // No valid value was found, so backtrack
-    return false;
+    index.push_back({uint64_t(file.tellp()), uint32_t(buffer.size()),
+                     uint32_t(puzzles.size())});
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    header.count += puzzles.size();
+    puzzles.clear();
   }
 
-	void minimize(){
-		TdokuLib tdoku(puzzle);
-		puzzle.load(tdoku.minimize());
-	}
+public:
+  PuzzleArchiveWriter() = default;
+  // puzzles, that are not canonical, are stored only if canonicalize is false
+  PuzzleArchiveWriter(const std::string &path, size_t block_size = 4096,
+                      bool canonicalize = true) {
+    open(path, block_size, canonicalize);
+  }
+  ~PuzzleArchiveWriter() { close(); }
+
+  bool open(const std::string &path, size_t block_size = 4096,
+            bool canonicalize = true) {
+    close();
+    this->block_size = std::max<size_t>(block_size, 1);
+    this->canonicalize = canonicalize;
+    header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    index.clear();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    return bool(file);
+  }
+  // puzzle is 81 chars, empty cells can be '0' or '.'
+  bool write(std::string_view puzzle) {
+    if (!file.is_open() || puzzle.size() != 81) {
+      return false;
+    }
+    std::string clues(81, '0');
+    for (int index = 0; index < 81; index++) {
+      if (puzzle[index] >= '1' && puzzle[index] <= '9') {
+        clues[index] = puzzle[index];
+      }
+    }
+    if (canonicalize) {
+      canonicalizer.minlex(clues, clues);
+    }
+    puzzles.push_back(clues);
+    if (puzzles.size() == block_size) {
+      write_block();
+    }
+    return bool(file);
+  }
+  // writes the last block and index of blocks
+  void close() {
+    if (!file.is_open()) {
+      return;
+    }
+    write_block();
+    header.block_count = index.size();
+    // index is read in place, so it is aligned
+    while (file.tellp() % alignof(BlockInfo) != 0) {
+      file.put(0);
+    }
+    header.index_offset = file.tellp();
+    file.write(reinterpret_cast<const char *>(index.data()),
+               index.size() * sizeof(BlockInfo));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+  }
+};
+
+class PuzzleArchiveReader : public PuzzleArchive {
+private:
+  int fd = -1;
+  const uint8_t *data = nullptr;
+  size_t file_size = 0;
+  Header header{};
+  const BlockInfo *index = nullptr;
 
 public:
-  Generator(unsigned int seed = 0) {
-		set_seed(seed);
-	}
-	void set_seed(unsigned int seed){
-		Tdoku::TdokuSetSeed(seed);
-		rg.seed(seed);
-	}
-  Puzzle generate() {
-    puzzle = {};
+  PuzzleArchiveReader() = default;
+  PuzzleArchiveReader(const std::string &path) { open(path); }
+  PuzzleArchiveReader(const PuzzleArchiveReader &) = delete;
+  PuzzleArchiveReader &operator=(const PuzzleArchiveReader &) = delete;
+  ~PuzzleArchiveReader() { close(); }
 
-    fill_diagonals();
-    // starting from second square
-    fill({3, 0});
+  bool open(const std::string &path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+      close();
+      return false;
+    }
+    file_size = st.st_size;
+    void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      close();
+      return false;
+    }
+    data = static_cast<const uint8_t *>(mapped);
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+        header.index_offset + header.block_count * sizeof(BlockInfo) >
+            file_size) {
+      close();
+      return false;
+    }
+    index = reinterpret_cast<const BlockInfo *>(data + header.index_offset);
+    return true;
+  }
+  void close() {
+    if (data != nullptr) {
+      munmap(const_cast<uint8_t *>(data), file_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+    data = nullptr;
+    index = nullptr;
+    header = {};
+  }
+  bool is_open() const { return data != nullptr; }
 
-		minimize();
-    return puzzle;
+  size_t size() const { return header.count; }
+  size_t block_count() const { return header.block_count; }
+  size_t block_puzzles(size_t block) const { return index[block].count; }
+
+  // Writes block_puzzles(block) * 81 chars of puzzles to out, empty cells are
+  // blank ('0' by default, Puzzle takes '.' too). Returns false if block is
+  // out of range or is corrupted, then out is filled only partly.
+  bool decode_block(size_t block, char *out, char blank = '0') const {
+    if (block >= block_count() ||
+        index[block].offset + index[block].size > header.index_offset) {
+      return false;
+    }
+    const uint8_t *in = data + index[block].offset;
+    size_t nibble = 0, end = size_t(index[block].size) * 2;
+    // 16 after the end of block
+    auto get = [&]() -> int {
+      if (nibble == end) {
+        return 16;
+      }
+      uint8_t res = (in[nibble / 2] >> (nibble % 2 * 4)) & 0xf;
+      nibble++;
+      return res;
+    };
+    for (size_t puzzle = 0; puzzle < index[block].count; puzzle++) {
+      char *cells = out + puzzle * 81;
+      int low = get(), high = get();
+      int prefix = low | (high << 4);
+      if (high == 16 || prefix > 81 || (puzzle == 0 && prefix != 0)) {
+        return false;
+      }
+      if (puzzle != 0) {
+        std::memcpy(cells, cells - 81, prefix);
+      }
+      int cell = prefix;
+      while (cell < 81) {
+        int code = get();
+        if (code >= 1 && code <= 9) {
+          cells[cell++] = '0' + code;
+          continue;
+        }
+        int count = code == 0 ? 1 : 2 << (code - 10);
+        if (code == 16 || cell + count > 81) {
+          return false;
+        }
+        std::memset(cells + cell, blank, count);
+        cell += count;
+      }
+    }
+    return true;
+  }
+  // empty string if block is out of range or is corrupted
+  std::string decode_block(size_t block, char blank = '0') const {
+    if (block >= block_count()) {
+      return std::string();
+    }
+    std::string res(block_puzzles(block) * 81, blank);
+    if (!decode_block(block, res.data(), blank)) {
+      res.clear();
+    }
+    return res;
+  }
+  // Decodes blocks in threads. Calls function(block, puzzles, count) from the
+  // thread, that decoded the block, puzzles are count * 81 chars. Corrupted
+  // blocks are skipped, then returns false.
+  template <class Function>
+  bool decode_parallel(size_t threads, Function function, char blank = '0') const {
+    std::atomic<size_t> next_block{0};
+    std::atomic<bool> is_ok{true};
+    auto work = [&]() {
+      std::vector<char> puzzles;
+      for (size_t block = next_block++; block < block_count();
+           block = next_block++) {
+        puzzles.resize(block_puzzles(block) * 81);
+        if (!decode_block(block, puzzles.data(), blank)) {
+          is_ok = false;
+          continue;
+        }
+        function(block, static_cast<const char *>(puzzles.data()),
+                 block_puzzles(block));
+      }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+      workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    return is_ok;
   }
 };
 } // namespace Sudoku
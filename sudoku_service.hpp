@@ -0,0 +1,496 @@
+#pragma once
+
+#include "sudoku_lib.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace Sudoku {
+// Local puzzle service over Unix domain socket. Every request is
+// RequestHeader, followed by 81 chars of puzzle for solve, rate and count.
+// Every response is ResponseHeader, followed by size bytes of payload:
+// + generate: 81 chars of puzzle
+// + solve: 81 chars of solution
+// + count: uint32_t number of solutions
+// + rate: int32_t score, uint32_t methods (see HumanSolver::methods_to_mask),
+//   uint8_t is_solved
+// + stats: text with latency of every request type
+// Responses come in order of completion, id of the response is id of the
+// request.
+namespace Service {
+enum RequestType : uint8_t {
+  generate = 0,
+  solve = 1,
+  rate = 2,
+  count = 3,
+  stats = 4,
+  request_types
+};
+enum Status : uint8_t { ok = 0, invalid_puzzle = 1, invalid_request = 2 };
+
+struct RequestHeader {
+  uint8_t type;
+  // for rate: 1 if puzzle is known to be unique
+  uint8_t is_unique;
+  // for count: the biggest number of solutions to find
+  uint16_t limit;
+  uint32_t id;
+};
+struct ResponseHeader {
+  uint8_t type;
+  uint8_t status;
+  uint16_t reserved;
+  uint32_t id;
+  uint32_t size;
+};
+
+inline bool read_all(int fd, void *data, size_t size) {
+  char *bytes = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t read = recv(fd, bytes, size, 0);
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      return false;
+    }
+    bytes += read;
+    size -= read;
+  }
+  return true;
+}
+inline bool write_all(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Latencies in microseconds, bucket i counts latencies in [2^i, 2^(i+1)).
+class LatencyHistogram {
+private:
+  std::array<std::atomic<uint64_t>, 32> buckets{};
+
+public:
+  void add(uint64_t microseconds) {
+    int bucket = microseconds == 0 ? 0 : 63 - __builtin_clzll(microseconds);
+    buckets[std::min(bucket, 31)]++;
+  }
+  uint64_t count() const {
+    uint64_t res = 0;
+    for (const auto &bucket : buckets) {
+      res += bucket;
+    }
+    return res;
+  }
+  // upper bound of the bucket, that has quantile (0-1) of latencies
+  uint64_t quantile(double quantile) const {
+    uint64_t total = count(), seen = 0;
+    for (int bucket = 0; bucket < 32; bucket++) {
+      seen += buckets[bucket];
+      if (total != 0 && seen >= quantile * total) {
+        return 2ull << bucket;
+      }
+    }
+    return 0;
+  }
+};
+
+// Requests are queued by connection threads. Workers take them from the
+// queue one at a time, so a burst of slow requests is spread over all
+// workers. Workers share StepCache and RatingCache and fill pool of generated
+// puzzles when they have nothing to do.
+class Server {
+public:
+  struct Options {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    // generated puzzles, waiting for generate requests
+    size_t pool_size = 64;
+    size_t step_cache_size = 1 << 16;
+    // optional, must outlive Server
+    RatingCache *rating_cache = nullptr;
+  };
+
+private:
+  struct Connection {
+    int fd;
+    std::mutex write_mutex;
+    ~Connection() { ::close(fd); }
+  };
+  struct Job {
+    std::shared_ptr<Connection> connection;
+    RequestHeader header;
+    std::array<char, 81> puzzle;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  Options options;
+  int listen_fd = -1;
+  std::string path;
+  std::atomic<bool> is_stopping{false};
+
+  std::deque<Job> jobs;
+  std::mutex jobs_mutex;
+  std::condition_variable jobs_ready;
+
+  std::vector<std::string> pool;
+  // number of workers, that generate puzzles for the pool
+  size_t filling = 0;
+  std::mutex pool_mutex;
+  std::atomic<uint32_t> next_seed{std::random_device{}()};
+
+  StepCache step_cache;
+  std::array<LatencyHistogram, request_types> histograms;
+
+  // thread is over when its connection is destroyed
+  struct ConnectionThread {
+    std::weak_ptr<Connection> connection;
+    std::thread thread;
+  };
+  std::vector<ConnectionThread> connections;
+
+  static const char *type_name(int type) {
+    static const char *names[] = {"generate", "solve", "rate", "count",
+                                  "stats"};
+    return names[type];
+  }
+
+  std::string generate_puzzle() {
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex);
+      if (!pool.empty()) {
+        std::string puzzle = std::move(pool.back());
+        pool.pop_back();
+        return puzzle;
+      }
+    }
+    return Generator(next_seed++).generate().clues_as_string();
+  }
+  // Returns false if pool is full or other workers fill it. One worker is
+  // always left for requests.
+  bool fill_pool() {
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex);
+      if (pool.size() + filling >= options.pool_size ||
+          (filling + 1 >= options.threads && options.threads > 1)) {
+        return false;
+      }
+      filling++;
+    }
+    std::string puzzle = Generator(next_seed++).generate().clues_as_string();
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    filling--;
+    pool.push_back(puzzle);
+    return true;
+  }
+
+  std::string stats_text() {
+    std::string res;
+    for (int type = 0; type < request_types; type++) {
+      const LatencyHistogram &histogram = histograms[type];
+      res += std::string(type_name(type)) +
+             ": count " + std::to_string(histogram.count()) +
+             ", p50 < " + std::to_string(histogram.quantile(0.5)) +
+             "us, p90 < " + std::to_string(histogram.quantile(0.9)) +
+             "us, p99 < " + std::to_string(histogram.quantile(0.99)) + "us\n";
+    }
+    return res;
+  }
+
+  void process(const Job &job) {
+    ResponseHeader response{job.header.type, ok, 0, job.header.id, 0};
+    std::string payload;
+    Puzzle puzzle;
+    bool has_puzzle = job.header.type == solve || job.header.type == rate ||
+                      job.header.type == count;
+    if (has_puzzle &&
+        !puzzle.load(std::string_view(job.puzzle.data(), job.puzzle.size()))) {
+      response.status = invalid_puzzle;
+    } else if (job.header.type == generate) {
+      payload = generate_puzzle();
+    } else if (job.header.type == solve) {
+      Puzzle solved;
+      if (TdokuLib(puzzle).solve(solved)) {
+        payload = solved.clues_as_string();
+      } else {
+        response.status = invalid_puzzle;
+      }
+    } else if (job.header.type == count) {
+      uint32_t solutions = TdokuLib(puzzle).count_solutions(
+          job.header.limit == 0 ? 1 : job.header.limit);
+      payload.assign(reinterpret_cast<const char *>(&solutions), 4);
+    } else if (job.header.type == rate) {
+      HumanSolver solver(puzzle, job.header.is_unique);
+      solver.set_step_cache(&step_cache);
+      solver.set_rating_cache(options.rating_cache);
+      HumanSolver::Result res = solver.solve();
+      int32_t score = res.score;
+      uint32_t methods = HumanSolver::methods_to_mask(res.used_methods);
+      uint8_t is_solved = res.is_solved;
+      payload.append(reinterpret_cast<const char *>(&score), 4);
+      payload.append(reinterpret_cast<const char *>(&methods), 4);
+      payload.append(reinterpret_cast<const char *>(&is_solved), 1);
+    } else if (job.header.type == stats) {
+      payload = stats_text();
+    } else {
+      response.status = invalid_request;
+    }
+    response.size = payload.size();
+    if (job.header.type < request_types) {
+      histograms[job.header.type].add(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - job.start)
+              .count());
+    }
+    std::lock_guard<std::mutex> lock(job.connection->write_mutex);
+    write_all(job.connection->fd, &response, sizeof(response)) &&
+        write_all(job.connection->fd, payload.data(), payload.size());
+  }
+
+  void work() {
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        if (jobs.empty() && !is_stopping) {
+          // generates puzzles for the pool while nobody asks for anything
+          lock.unlock();
+          bool is_filled = fill_pool();
+          lock.lock();
+          if (!is_filled) {
+            jobs_ready.wait(lock, [&] { return !jobs.empty() || is_stopping; });
+          }
+        }
+        if (jobs.empty()) {
+          if (is_stopping) {
+            return;
+          }
+          continue;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      process(job);
+    }
+  }
+
+  void read_requests(std::shared_ptr<Connection> connection) {
+    Job job;
+    job.connection = connection;
+    while (read_all(connection->fd, &job.header, sizeof(job.header))) {
+      if ((job.header.type == solve || job.header.type == rate ||
+           job.header.type == count) &&
+          !read_all(connection->fd, job.puzzle.data(), job.puzzle.size())) {
+        break;
+      }
+      job.start = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> lock(jobs_mutex);
+      jobs.push_back(job);
+      jobs_ready.notify_one();
+    }
+  }
+
+public:
+  Server() : Server(Options()) {}
+  Server(Options options)
+      : options{options}, step_cache{options.step_cache_size} {}
+  ~Server() {
+    stop();
+    if (listen_fd >= 0) {
+      ::close(listen_fd);
+      unlink(path.c_str());
+    }
+  }
+
+  // Creates socket file (old one is removed). Returns false on error.
+  bool listen(const std::string &socket_path) {
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+      return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (listen_fd < 0 ||
+        bind(listen_fd, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+        ::listen(listen_fd, 64) != 0) {
+      return false;
+    }
+    path = socket_path;
+    return true;
+  }
+
+  // Accepts connections until stop is called.
+  void run() {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < options.threads; i++) {
+      workers.emplace_back([this] { work(); });
+    }
+    while (!is_stopping) {
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) {
+        if (errno == EINTR && !is_stopping) {
+          continue;
+        }
+        break;
+      }
+      auto connection = std::make_shared<Connection>();
+      connection->fd = fd;
+      auto is_over = [](ConnectionThread &connection) {
+        if (!connection.connection.expired()) {
+          return false;
+        }
+        connection.thread.join();
+        return true;
+      };
+      connections.erase(
+          std::remove_if(connections.begin(), connections.end(), is_over),
+          connections.end());
+      connections.push_back(
+          {connection, std::thread([this, connection] {
+             read_requests(connection);
+           })});
+    }
+    for (ConnectionThread &connection : connections) {
+      // wakes up the thread
+      if (auto alive = connection.connection.lock()) {
+        shutdown(alive->fd, SHUT_RDWR);
+      }
+    }
+    for (ConnectionThread &connection : connections) {
+      connection.thread.join();
+    }
+    connections.clear();
+    {
+      std::lock_guard<std::mutex> lock(jobs_mutex);
+      is_stopping = true;
+    }
+    jobs_ready.notify_all();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  // Can be called from other thread or from signal handler.
+  void stop() {
+    is_stopping = true;
+    if (listen_fd >= 0) {
+      shutdown(listen_fd, SHUT_RDWR);
+    }
+  }
+};
+
+// Blocking client, one request at a time.
+class Client {
+private:
+  int fd = -1;
+  uint32_t next_id = 0;
+
+  bool request(RequestHeader header, const char *puzzle,
+               ResponseHeader &response, std::string &payload) {
+    header.id = next_id++;
+    if (fd < 0 || !write_all(fd, &header, sizeof(header)) ||
+        (puzzle != nullptr && !write_all(fd, puzzle, 81)) ||
+        !read_all(fd, &response, sizeof(response))) {
+      return false;
+    }
+    payload.resize(response.size);
+    return read_all(fd, payload.data(), payload.size()) &&
+           response.id == header.id && response.status == ok;
+  }
+  bool request_with_puzzle(RequestHeader header, std::string_view puzzle,
+                           std::string &payload) {
+    if (puzzle.size() != 81) {
+      return false;
+    }
+    ResponseHeader response;
+    return request(header, puzzle.data(), response, payload);
+  }
+
+public:
+  Client() = default;
+  Client(const std::string &socket_path) { connect(socket_path); }
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+  ~Client() { close(); }
+
+  bool connect(const std::string &socket_path) {
+    close();
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+      return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                            sizeof(address)) != 0) {
+      close();
+      return false;
+    }
+    return true;
+  }
+  void close() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+  }
+  bool is_connected() const { return fd >= 0; }
+
+  // All methods return false if request failed or puzzle is invalid.
+  bool generate(std::string &puzzle) {
+    ResponseHeader response;
+    return request({Service::generate, 0, 0, 0}, nullptr, response, puzzle);
+  }
+  bool solve(std::string_view puzzle, std::string &solution) {
+    return request_with_puzzle({Service::solve, 0, 0, 0}, puzzle, solution);
+  }
+  bool count(std::string_view puzzle, uint16_t limit, uint32_t &solutions) {
+    std::string payload;
+    if (!request_with_puzzle({Service::count, 0, limit, 0}, puzzle, payload) ||
+        payload.size() != 4) {
+      return false;
+    }
+    std::memcpy(&solutions, payload.data(), 4);
+    return true;
+  }
+  bool rate(std::string_view puzzle, bool is_unique,
+            RatingCache::Record &record) {
+    std::string payload;
+    if (!request_with_puzzle({Service::rate, is_unique, 0, 0}, puzzle,
+                             payload) ||
+        payload.size() != 9) {
+      return false;
+    }
+    std::memcpy(&record.score, payload.data(), 4);
+    std::memcpy(&record.methods, payload.data() + 4, 4);
+    record.is_solved = payload[8];
+    return true;
+  }
+  std::string stats() {
+    ResponseHeader response;
+    std::string payload;
+    request({Service::stats, 0, 0, 0}, nullptr, response, payload);
+    return payload;
+  }
+};
+} // namespace Service
+} // namespace Sudoku
@@ -2,6 +2,7 @@
 #include "simd_vectors.h"
 #include "util.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstring>
@@ -698,6 +699,7 @@ struct SolverDpllTriadSimd {
 
 struct GeneratorDpllTriadSimd {
     SolverDpllTriadSimd<0> solver_{};
+    SolverDpllTriadSimd<1> solution_solver_{};
     Util util_;
 
     // takes a partial puzzle (vanilla or pencilmark) and adds random clues to reconstrain it
@@ -757,6 +759,79 @@ struct GeneratorDpllTriadSimd {
         return false;
     }
 
+    // assigns digits to the cells of pattern (non-'.' cells of puzzle) so that puzzle has a
+    // unique solution. returns false if no assignment is found in max_counts counts of
+    // solutions (then the pattern cells of puzzle are '.').
+    bool ConstrainPattern(char *puzzle, size_t max_counts) {
+        vector<int> cells;
+        for (int cell : util_.Permutation(81)) {
+            if (puzzle[cell] != '.') {
+                cells.push_back(cell);
+                puzzle[cell] = '.';
+            }
+        }
+        char input[82] = {};
+        std::memcpy(input, puzzle, 81);
+        size_t counts = 0;
+        if (!ConstrainPattern(State{}, cells, input, counts, max_counts)) return false;
+        std::memcpy(puzzle, input, 81);
+        return true;
+    }
+
+    // assigns the cell with the fewest candidates left by propagation, digits are tried in
+    // random order. assignments, that BoxRestrict finds contradictory, are never counted.
+    bool ConstrainPattern(const State &state, vector<int> cells, char *puzzle,
+                          size_t &counts, size_t max_counts) {
+        if (cells.empty()) return false;
+        size_t best = 0;
+        int best_count = 10;
+        for (size_t i = 0; i < cells.size(); i++) {
+            const BoxIndexing &indexing = tables.box_indexing[cells[i]];
+            int count = NumBitsSet(state.boxen[indexing.box].cells.Extract(indexing.elem));
+            if (count < best_count) {
+                best = i;
+                best_count = count;
+            }
+        }
+        int cell = cells[best];
+        cells[best] = cells.back();
+        cells.pop_back();
+
+        const BoxIndexing &indexing = tables.box_indexing[cell];
+        const Box &box = state.boxen[indexing.box];
+        uint16_t candidates = box.cells.Extract(indexing.elem);
+        for (int digit : util_.Permutation(9)) {
+            uint16_t candidate = 1u << digit;
+            if (!(candidates & candidate)) continue;
+            Cells16 restrict = box.cells;
+            restrict.Insert(indexing.elem, candidate);
+            State test_state = state;
+            if (!SolverDpllTriadSimd<0>::BoxRestrict<0>(test_state, indexing.box, restrict)) {
+                continue;
+            }
+            if (counts++ >= max_counts) break;
+            puzzle[cell] = (char)('1' + digit);
+            switch (solver_.SafeCountSolutionsConsistentWithPartialAssignment(test_state, 2)) {
+                case 0:
+                    break;
+                case 1: {
+                    // the rest of the pattern gets digits of the unique solution
+                    char solution[81];
+                    size_t num_guesses;
+                    solution_solver_.SolveSudoku(puzzle, 1, solution, &num_guesses);
+                    for (int other : cells) puzzle[other] = solution[other];
+                    return true;
+                }
+                default:
+                    if (ConstrainPattern(test_state, cells, puzzle, counts, max_counts)) {
+                        return true;
+                    }
+            }
+            puzzle[cell] = '.';
+        }
+        return false;
+    }
+
     // minimizes a vanilla or pencilmark puzzle by testing removal of all clues in random order,
     // restoring any clue that's required to keep the solution unique. if the 'monotonic' flag
     // is passed, returns true only if we had a minimal puzzle after the first restored clue.
@@ -787,14 +862,64 @@ struct GeneratorDpllTriadSimd {
         }
         return true;
     }
+
+    // cells, that are mapped to cell by any combination of maps of symmetry
+    // (flags of TdokuMinimizeSymmetric), cell included.
+    static vector<int> SymmetryOrbit(int cell, uint32_t symmetry) {
+        vector<int> orbit = {cell};
+        for (size_t i = 0; i < orbit.size(); i++) {
+            int row = orbit[i] / 9, col = orbit[i] % 9;
+            int images[6] = {(8 - row) * 9 + 8 - col, col * 9 + row,
+                             (8 - col) * 9 + 8 - row, (8 - row) * 9 + col,
+                             row * 9 + 8 - col, col * 9 + 8 - row};
+            for (int map = 0; map < 6; map++) {
+                if ((symmetry & (1u << map)) &&
+                    std::find(orbit.begin(), orbit.end(), images[map]) == orbit.end()) {
+                    orbit.push_back(images[map]);
+                }
+            }
+        }
+        return orbit;
+    }
+
+    // minimizes a vanilla puzzle like Minimize, but removes and restores clues by orbits of
+    // symmetry, so symmetric puzzle stays symmetric and one uniqueness check covers the
+    // whole orbit.
+    bool MinimizeSymmetric(bool monotonic, uint32_t symmetry, char *puzzle) {
+        bool restored_clue = false;
+        bool tested[81] = {};
+        vector<int> permutation = util_.Permutation(81);
+        for (int cell : permutation) {
+            if (tested[cell] || puzzle[cell] == '.') continue;
+            vector<int> orbit = SymmetryOrbit(cell, symmetry);
+            char constraints[8];
+            for (size_t i = 0; i < orbit.size(); i++) {
+                tested[orbit[i]] = true;
+                constraints[i] = puzzle[orbit[i]];
+                puzzle[orbit[i]] = '.';
+            }
+            State state;
+            SolverDpllTriadSimd<0>::InitVanillaByBand(puzzle, state);
+            if (solver_.SafeCountSolutionsConsistentWithPartialAssignment(state, 2) > 1) {
+                for (size_t i = 0; i < orbit.size(); i++) {
+                    puzzle[orbit[i]] = constraints[i];
+                }
+                restored_clue = true;
+            } else if (monotonic && restored_clue) {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
 
-SolverDpllTriadSimd<0> solver_none{};
-SolverDpllTriadSimd<1> solver_last{};
-SolverDpllTriadSimd<2> solver_enum{};
+// every thread has its own solvers, so puzzles can be solved in parallel
+thread_local SolverDpllTriadSimd<0> solver_none{};
+thread_local SolverDpllTriadSimd<1> solver_last{};
+thread_local SolverDpllTriadSimd<2> solver_enum{};
 
-GeneratorDpllTriadSimd generator{};
+thread_local GeneratorDpllTriadSimd generator{};
 
 } // namespace
 
@@ -828,6 +953,16 @@ bool TdokuMinimize(bool pencilmark, bool monotonic, char *puzzle) {
     return generator.Minimize(pencilmark, monotonic, puzzle);
 }
 
+extern "C"
+bool TdokuConstrainPattern(char *puzzle, size_t max_counts) {
+    return generator.ConstrainPattern(puzzle, max_counts);
+}
+
+extern "C"
+bool TdokuMinimizeSymmetric(bool monotonic, uint32_t symmetry, char *puzzle) {
+    return generator.MinimizeSymmetric(monotonic, symmetry, puzzle);
+}
+
 extern "C"
 void TdokuSetSeed(uint64_t seed) {
 	generator.util_.RandomSeed(seed);
@@ -26,8 +26,12 @@ size_t TdokuEnumerate(const char *puzzle,
 
 bool TdokuConstrain(bool pencilmark, char *puzzle);
 
+bool TdokuConstrainPattern(char *puzzle, size_t max_counts);
+
 bool TdokuMinimize(bool pencilmark, bool monotonic, char *puzzle);
 
+bool TdokuMinimizeSymmetric(bool monotonic, uint32_t symmetry, char *puzzle);
+
 void TdokuSetSeed(uint64_t seed);
 #ifdef __cplusplus
 }
@@ -98,6 +102,21 @@ static inline bool Constrain(bool pencilmark, char *puzzle) {
     return TdokuConstrain(pencilmark, puzzle);
 }
 
+/**
+ * Assigns digits to the cells of the pattern so that the puzzle has a unique solution. Cells
+ * with the fewest candidates (after propagation) are assigned first, digits are tried in random
+ * order, contradictory assignments are pruned before counting solutions.
+ * @param puzzle
+ *       An 81 character pattern: every cell, that is not '.', gets a digit. Other cells stay '.'.
+ * @param max_counts
+ *       Number of solution counts after which the search gives up.
+ * @return
+ *       A boolean indicating success or failure (then pattern cells are '.').
+ */
+static inline bool ConstrainPattern(char *puzzle, size_t max_counts) {
+    return TdokuConstrainPattern(puzzle, max_counts);
+}
+
 /**
  * Minimizes a vanilla or pencilmark puzzle by testing removal of all clues in random order,
  * restoring any clue that's required to keep the solution unique.
@@ -113,4 +132,21 @@ static inline bool Minimize(bool pencilmark, bool monotonic, char *puzzle) {
     return TdokuMinimize(pencilmark, monotonic, puzzle);
 }
 
+/**
+ * Minimizes a vanilla puzzle like Minimize, but tests removal of clues by orbits of symmetry
+ * (all clues of orbit are removed or restored together), so symmetric puzzle stays symmetric.
+ * @param monotonic
+ *       A boolean indicating the minimizer should return true only if we have a minimal
+ *       puzzle after the first restored orbit.
+ * @param symmetry
+ *       Flags of maps of cells (row, col): 1 - rotation by 180 degrees, 2 - main diagonal
+ *       mirror, 4 - anti-diagonal mirror, 8 - horizontal mirror (row -> 8 - row),
+ *       16 - vertical mirror (col -> 8 - col), 32 - rotation by 90 degrees.
+ * @param puzzle
+ *       An 81 character puzzle to minimize
+ */
+static inline bool MinimizeSymmetric(bool monotonic, uint32_t symmetry, char *puzzle) {
+    return TdokuMinimizeSymmetric(monotonic, symmetry, puzzle);
+}
+
 #endif //TDOKU_H
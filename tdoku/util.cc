@@ -7,11 +7,11 @@
 using namespace std;
 
 void Util::RandomSeed(uint64_t seed) {
-    rng_.seed(seed);
+    rng_.Seed(seed);
 }
 
 uint32_t Util::RandomUInt() {
-    return random_uint_(rng_);
+    return (uint32_t)(rng_() >> 32);
 }
 
 double Util::RandomDouble() {
@@ -23,7 +23,7 @@ vector<int> Util::Permutation(size_t size) {
     vector<int> permutation;
     permutation.reserve(size);
     for (size_t i = 0; i < size; i++) permutation.push_back(i);
-    shuffle(permutation.begin(), permutation.end(), rng_);
+    Shuffle(permutation.begin(), permutation.end());
     return permutation;
 }
 
@@ -31,10 +31,10 @@ vector<int> Util::Permutation(size_t size) {
 // within a band, but rows or columns may not be exchanged between bands.
 void Util::BlockShuffle(array<int, 9> *vec) {
     array<int, 3> blocks{0, 1, 2};
-    shuffle(blocks.begin(), blocks.end(), rng_);
+    Shuffle(blocks.begin(), blocks.end());
     for (int i = 0; i < 3; i++) {
         array<int, 3> block{0, 1, 2};
-        shuffle(block.begin(), block.end(), rng_);
+        Shuffle(block.begin(), block.end());
         for (int j = 0; j < 3; j++) {
             (*vec)[i * 3 + j] = blocks[i] * 3 + block[j];
         }
@@ -45,7 +45,7 @@ void Util::BlockShuffle(array<int, 9> *vec) {
 // equivalent puzzle.
 void Util::PermuteSudoku(char *puzzle, bool pencilmark) {
     array<int, 9> digit_permutation{0, 1, 2, 3, 4, 5, 6, 7, 8};
-    shuffle(digit_permutation.begin(), digit_permutation.end(), rng_);
+    Shuffle(digit_permutation.begin(), digit_permutation.end());
 
     array<int, 9> row_permutation{0, 1, 2, 3, 4, 5, 6, 7, 8};
     array<int, 9> col_permutation{0, 1, 2, 3, 4, 5, 6, 7, 8};
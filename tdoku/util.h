@@ -1,14 +1,49 @@
 #include <array>
+#include <cstdint>
 #include <random>
+#include <utility>
 #include <vector>
 
+// counter-based generator in the style of SplitMix64: value number n is a pure function of
+// (key, n), so a stream is reproduced from its seed alone and streams share no state.
+struct CounterRng {
+    using result_type = uint64_t;
+    uint64_t key = 0;
+    uint64_t counter = 0;
+
+    static uint64_t Mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+    void Seed(uint64_t seed) {
+        key = Mix(seed);
+        counter = 0;
+    }
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+    result_type operator()() { return Mix(key + ++counter * 0x9e3779b97f4a7c15ull); }
+    // random number in range(0,bound), the same with every standard library
+    uint32_t Below(uint32_t bound) { return (uint64_t)(uint32_t)((*this)() >> 32) * bound >> 32; }
+};
+
 class Util {
 private:
     std::random_device rd{};
-    std::mt19937_64 rng_{rd()};
-    std::uniform_int_distribution<uint32_t> random_uint_{};
+    CounterRng rng_{CounterRng::Mix(rd()), 0};
     std::uniform_real_distribution<> random_double_{0.0, 1.0};
 
+    // Fisher-Yates with CounterRng::Below, so permutations don't depend on std::shuffle
+    template <class It>
+    void Shuffle(It first, It last) {
+        for (size_t i = last - first; i > 1; i--) {
+            std::swap(first[i - 1], first[rng_.Below(i)]);
+        }
+    }
+
 public:
     void RandomSeed(uint64_t seed);
     uint32_t RandomUInt();
@@ -1,9 +1,11 @@
 #include "sudoku_lib.hpp"
+#include "sudoku_service.hpp"
 #include "tdoku/tdoku.h"
 #include <bits/chrono.h>
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <fstream>
 #include <random>
 
 class InputParser {
@@ -32,18 +34,20 @@ private:
   std::vector<std::string> tokens;
 };
 
-Sudoku::HumanSolver::Result test_puzzle(std::string puzzle_string) {
+Sudoku::HumanSolver::Result test_puzzle(std::string puzzle_string,
+                                        bool is_unique = false) {
   Sudoku::Puzzle puzzle;
   if (!puzzle.load(puzzle_string)) {
     std::exit(1);
   }
-  Sudoku::HumanSolver solver{puzzle};
+  Sudoku::HumanSolver solver{puzzle, is_unique};
   Sudoku::HumanSolver::Result solver_result = solver.solve();
   return solver_result;
 }
 
-void compare_res(std::string puzzle, Sudoku::HumanSolver::Result res_to_check) {
-  Sudoku::HumanSolver::Result res = test_puzzle(puzzle);
+void compare_res(std::string puzzle, Sudoku::HumanSolver::Result res_to_check,
+                 bool is_unique = false) {
+  Sudoku::HumanSolver::Result res = test_puzzle(puzzle, is_unique);
   if (res != res_to_check) {
     std::cout << "\033[31mFailed!\033[0m\n";
     std::cout << res;
@@ -51,6 +55,14 @@ void compare_res(std::string puzzle, Sudoku::HumanSolver::Result res_to_check) {
   }
 }
 
+// stops tests with message, if condition is false
+void expect(bool condition, const std::string &message) {
+  if (!condition) {
+    std::cout << "\033[31mFailed!\033[0m " << message << "\n";
+    std::exit(1);
+  }
+}
+
 void test_human_solver(){
   compare_res("0010005707060500039006300400250730903670801540805402300700620096"
               "00090702093000400",
@@ -157,19 +169,968 @@ void test_human_solver(){
                 "Single Candidate", "Single Position", "X-Wing"}});
   compare_res("6249000007391000088150040004000093703000400065910030029004002001"
               "00296004248357169",
-              {1135,
+              {1055,
                true,
-               {"Candidate Lines", "Double Pairs", "Naked Pair", "Naked Quad",
-                "Single Candidate", "Single Position"}});
+               {"Candidate Lines", "Double Pairs", "Forcing Chains",
+                "Naked Pair", "Single Candidate", "Single Position"}});
+  // naked 3
+  compare_res("6008027357023569403004070621009750242001830790796240034005602070"
+              "67240300920738406",
+              {1145,
+               true,
+               {"Candidate Lines", "Forcing Chains", "Naked Triple",
+                "Single Candidate"}});
+  compare_res("1284007009730010404560700100020100968605030717100648000910403200"
+              "00100000007005104",
+              {1840,
+               true,
+               {"Candidate Lines", "Double Pairs", "Forcing Chains",
+                "Hidden Pair", "Hidden Triple", "Single Candidate",
+                "Single Position", "X-Wing"}});
+  // uniqueness based methods
+  compare_res("0102450809001600000003000043600500080200900600000000028300004700"
+              "90000210000000000",
+              {1295,
+               true,
+               {"BUG+1", "Hidden Pair", "Naked Pair", "Single Candidate",
+                "Single Position", "Unique Rectangle"}},
+              true);
+  // set equivalence
+  compare_res("0504060000070800002000005000030109001703000008002000500009008009"
+              "10000003560800002",
+              {1690,
+               true,
+               {"Candidate Lines", "Forcing Chains", "Naked Pair",
+                "Naked Triple", "Set Equivalence", "Single Candidate",
+                "Single Position"}});
+  // naked 4 is reached only without Forcing Chains, they come before it
+  Sudoku::Puzzle naked_quad(
+      "6249000007391000088150040004000093703000400065910030029004002001"
+      "00296004248357169");
+  Sudoku::HumanSolver without_chains(naked_quad, false);
+  without_chains.set_forcing_chains_limits({0, 0});
+  Sudoku::HumanSolver::Result naked_quad_res = without_chains.solve();
+  if (naked_quad_res != Sudoku::HumanSolver::Result{
+                            1135,
+                            true,
+                            {"Candidate Lines", "Double Pairs", "Naked Pair",
+                             "Naked Quad", "Single Candidate",
+                             "Single Position"}}) {
+    std::cout << "\033[31mFailed!\033[0m Naked Quad isn't used\n";
+    std::cout << naked_quad_res;
+    std::exit(1);
+  }
 	// TODO: implement those like tests
   // test_puzzle("901500046425090081860010020502000000019000460600000002196040253200060817000001694");
-  // test_puzzle("600802735702356940300407062100975024200183079079624003400560207067240300920738406");
-  // // naked 3
-  // test_puzzle("128400700973001040456070010002010096860503071710064800091040320000100000007005104");
   // test_puzzle("800000000003600000070090200050007000000045700000100030001000068008500010090000400");
   // // Hardest sudoku ever
 }
 
+// solving with cached steps must give the same results
+void test_step_cache(){
+	std::vector<std::string> puzzles = {
+		"005403670006002400000100300070046003000000000600750020001008000003200900098504100",
+		"000006509000300070018000030009030004200060007600050800040000710050003000107800000",
+		"000060010000010300100803004020600900009537400007002080900701006003040000080020000",
+	};
+	Sudoku::StepCache cache(1 << 10);
+	for (int pass = 0; pass < 2; pass++){
+		for (std::string puzzle : puzzles){
+			Sudoku::HumanSolver solver{Sudoku::Puzzle(puzzle)};
+			solver.set_step_cache(&cache);
+			Sudoku::HumanSolver::Result res = solver.solve();
+			if (res != test_puzzle(puzzle)){
+				std::cout << "\033[31mFailed!\033[0m Cached result differs:\n" << res;
+				std::exit(1);
+			}
+		}
+	}
+	if (cache.get_stats().hits == 0){
+		std::cout << "\033[31mFailed!\033[0m Step cache was never hit\n";
+		std::exit(1);
+	}
+}
+
+// singles sweep must give the same score and methods as singles step by step
+void test_singles_sweep(){
+	std::vector<std::string> puzzles = {
+		"005403670006002400000100300070046003000000000600750020001008000003200900098504100",
+		"000006509000300070018000030009030004200060007600050800040000710050003000107800000",
+		"000060010000010300100803004020600900009537400007002080900701006003040000080020000",
+	};
+	for (int i=0; i<20; i++){
+		puzzles.push_back(Sudoku::Generator(i).generate().clues_as_string());
+	}
+	for (const std::string &puzzle : puzzles){
+		Sudoku::HumanSolver sweep{Sudoku::Puzzle(puzzle)}, steps{Sudoku::Puzzle(puzzle)};
+		steps.set_singles_sweep(false);
+		Sudoku::HumanSolver::Result sweep_res = sweep.solve(), steps_res = steps.solve();
+		if (sweep_res.score != steps_res.score || sweep_res.used_methods != steps_res.used_methods ||
+				sweep_res.is_solved != steps_res.is_solved){
+			std::cout << "\033[31mFailed!\033[0m Singles sweep differs for " << puzzle << ":\n"
+				<< sweep_res << steps_res;
+			std::exit(1);
+		}
+	}
+}
+
+// hints must follow pencilmarks of the player and lead to the solution, the
+// second game must be solved by lookups only
+void test_hints(){
+	std::string puzzle = "005403670006002400000100300070046003000000000600750020001008000003200900098504100";
+	std::string solution = Sudoku::TdokuLib(Sudoku::Puzzle(puzzle)).solve().clues_as_string();
+	Sudoku::Hints hints;
+	for (int pass = 0; pass < 2; pass++){
+		Sudoku::Puzzle state(puzzle);
+		// player leaves only the right candidate in the first empty cell
+		size_t first = puzzle.find('0');
+		int digit = solution[first] - '0';
+		for (int wrong = 1; wrong <= 9; wrong++){
+			if (wrong != digit) state.remove_pencilmark_from_cell(Sudoku::Pos::from_index(first), wrong);
+		}
+		uint64_t misses = hints.get_stats().misses;
+		Sudoku::SolvingStep step = hints.next_step(state);
+		std::string at = ", pass " + std::to_string(pass);
+		expect(step.method == "Single Candidate" && step.placements.size() == 1 &&
+			step.placements[0].first == Sudoku::Pos::from_index(first) && step.placements[0].second == digit,
+			"Hints miss the candidate left by player" + at);
+		while (step.method != ""){
+			step.apply(state);
+			if (!state.is_space_for_clues_avalible()) break;
+			step = hints.next_step(state);
+		}
+		expect(state.clues_as_string() == solution, "Hints don't solve the puzzle" + at);
+		expect(pass == 0 || hints.get_stats().misses == misses, "Hints miss the cache on the second pass");
+	}
+}
+
+// game state must play like Puzzle, survive serialization and undo
+void test_game_state(){
+	std::string clues = "000006509000300070018000030009030004200060007600050800040000710050003000107800000";
+	std::string solution = Sudoku::TdokuLib(Sudoku::Puzzle(clues)).solve().clues_as_string();
+	Sudoku::Puzzle puzzle(clues);
+	puzzle.remove_pencilmark_from_cell(Sudoku::Pos::from_index(0), solution[0] == '3' ? 4 : 3);
+	Sudoku::GameState state(puzzle);
+	Sudoku::GameState start = state;
+	Sudoku::GameHistory history(state);
+	expect(sizeof(Sudoku::GameState) == 162, "GameState isn't 162 bytes");
+	expect(state.puzzle().clues_as_string() == clues, "GameState::puzzle has wrong clues");
+	for (int index = 0; index < 81; index++){
+		if (clues[index] != '0') continue;
+		puzzle.set_clue(Sudoku::Pos::from_index(index), solution[index] - '0');
+		state.place(index, solution[index] - '0');
+		history.push(state);
+		Sudoku::GameState restored;
+		Sudoku::Puzzle restored_puzzle = state.puzzle();
+		std::string bytes = state.serialize();
+		std::string move = " after move at " + std::to_string(index);
+		expect(restored.deserialize(bytes) && restored == state, "GameState is deserialized wrong" + move);
+		expect(bytes.size() < sizeof(state), "serialized GameState isn't smaller than GameState" + move);
+		expect(!restored.deserialize(bytes.substr(1)), "truncated GameState is deserialized" + move);
+		expect(Sudoku::CandidateGrid(puzzle) == state.grid(), "GameState doesn't play like Puzzle" + move);
+		expect(Sudoku::GameState(restored_puzzle) == state, "GameState::puzzle doesn't convert back" + move);
+	}
+	expect(state.puzzle().clues_as_string() == solution, "GameState isn't solved by all moves");
+	while (history.undo()){}
+	expect(history.state() == start, "GameHistory doesn't undo to the start");
+	expect(history.redo() && history.state() != start, "GameHistory doesn't redo");
+	// push after undo drops states, that could be redone
+	history.push(start);
+	expect(history.size() == 3 && !history.redo(), "GameHistory keeps states to redo after push");
+	expect(history.undo() && history.undo() && history.state() == start && !history.undo(),
+		"GameHistory undoes wrong after push");
+	// a conflicting move must keep the candidates of the state in Puzzle
+	Sudoku::GameState conflicting = start;
+	conflicting.place(0, clues[6] - '0');
+	Sudoku::Puzzle conflicting_puzzle = conflicting.puzzle();
+	expect(Sudoku::CandidateGrid(conflicting_puzzle) == conflicting.grid() &&
+		Sudoku::GameState(conflicting_puzzle) == conflicting,
+		"GameState::puzzle loses candidates of a conflicting state");
+}
+
+// checks of moves must agree with Puzzle after every random move
+void test_game_session(){
+	std::string clues = "000060010000010300100803004020600900009537400007002080900701006003040000080020000";
+	std::string solution = Sudoku::TdokuLib(Sudoku::Puzzle(clues)).solve().clues_as_string();
+	Sudoku::GameSession session(clues);
+	Sudoku::Puzzle puzzle(clues);
+	std::mt19937 random(5);
+	expect(session.has_solution(), "GameSession has no solution");
+	expect(!session.set(4, 1), "GameSession changes a given");
+	expect(!Sudoku::GameSession().load("11" + std::string(79, '0')), "GameSession loads conflicting clues");
+	for (int move = 0; move < 2000; move++){
+		int index = random() % 81, digit = random() % 10;
+		Sudoku::Pos pos = Sudoku::Pos::from_index(index);
+		std::string at = " at move " + std::to_string(move);
+		if (session.digit(index) == 0 && digit != 0){
+			expect(session.conflicts(index, digit) == !puzzle.is_valid_clue(pos, digit),
+				"GameSession::conflicts disagrees with Puzzle" + at);
+		}
+		if (session.set(index, digit)){
+			puzzle.set_clue(pos, digit);
+		}
+		for (int cell = 0; cell < 81; cell++){
+			int value = session.digit(cell);
+			bool is_conflict = value != 0 && session.conflicts(cell, value);
+			bool is_wrong = value != 0 && !session.is_given(cell) && !session.matches_solution(cell, value);
+			expect(value == puzzle.get_clues()[Sudoku::Pos::from_index(cell)],
+				"GameSession digits differ from Puzzle" + at);
+			expect(session.conflicting_cells().test(cell) == is_conflict,
+				"GameSession::conflicting_cells disagrees with conflicts" + at);
+			expect(session.wrong_cells().test(cell) == is_wrong,
+				"GameSession::wrong_cells disagrees with matches_solution" + at);
+		}
+	}
+	for (int index = 0; index < 81; index++){
+		expect(!session.is_complete(), "GameSession is complete before the last cell");
+		session.set(index, solution[index] - '0');
+	}
+	expect(session.is_complete(), "GameSession isn't complete with the solution");
+	expect(session.wrong_cells().empty(), "GameSession has wrong cells with the solution");
+	// cell 8 has no candidates, so nothing can be wrong
+	Sudoku::GameSession unsolvable("123456780000000009" + std::string(63, '0'));
+	expect(!unsolvable.has_solution() && unsolvable.set(20, 5) && unsolvable.wrong_cells().empty(),
+		"GameSession marks wrong cells without solution");
+	expect(!unsolvable.conflicts(20, 0) && !unsolvable.matches_solution(20, 0),
+		"GameSession accepts digit 0 in checks");
+}
+
+// parser must find errors without printing and agree with Puzzle
+void test_puzzle_parser(){
+	std::string clues = "005403670006002400000100300070046003000000000600750020001008000003200900098504100";
+	std::stringstream printed;
+	std::ios::iostate cout_state = std::cout.rdstate();
+	std::streambuf *cout_buffer = std::cout.rdbuf(printed.rdbuf());
+	Sudoku::CandidateGrid grid;
+	std::string dots = clues;
+	std::replace(dots.begin(), dots.end(), '0', '.');
+	Sudoku::ParseResult ok = grid.parse(dots), short_one = grid.parse(clues.substr(1));
+	std::string wrong = clues, repeated = clues;
+	wrong[70] = 'x';
+	repeated[80] = '1';
+	Sudoku::ParseResult wrong_char = grid.parse(wrong), repeated_digit = grid.parse(repeated);
+	bool is_parsed = grid.parse(clues) ? true : false;
+	// Puzzle reports errors without printing too
+	Sudoku::Puzzle puzzle;
+	Sudoku::ParseResult puzzle_wrong_char = puzzle.parse(wrong);
+	bool are_loaded = !puzzle.load(clues.substr(1)) && !puzzle.load(repeated) && puzzle.load(clues);
+	std::cout.rdbuf(cout_buffer);
+	std::cout.setstate(cout_state);
+	expect(printed.str().empty(), "PuzzleParser or Puzzle prints while parsing");
+	expect(ok && is_parsed, "PuzzleParser rejects a right puzzle");
+	expect(grid == Sudoku::CandidateGrid(puzzle), "PuzzleParser disagrees with Puzzle");
+	expect(short_one.error == Sudoku::ParseResult::wrong_size, "PuzzleParser misses wrong size");
+	expect(wrong_char.error == Sudoku::ParseResult::wrong_char && wrong_char.index == 70,
+		"PuzzleParser misses wrong char");
+	expect(repeated_digit.error == Sudoku::ParseResult::repeated_digit && repeated_digit.index == 80,
+		"PuzzleParser misses repeated digit");
+	expect(puzzle_wrong_char.error == Sudoku::ParseResult::wrong_char && puzzle_wrong_char.index == 70,
+		"Puzzle::parse misses wrong char");
+	expect(are_loaded, "Puzzle::load accepts a wrong puzzle or rejects a right one");
+}
+
+// batch validation must agree with scalar validation and with Puzzle
+void test_grid_validator(){
+	std::string solution = Sudoku::TdokuLib(Sudoku::Puzzle(
+		"000006509000300070018000030009030004200060007600050800040000710050003000107800000")).solve().clues_as_string();
+	Sudoku::Utility::CounterRng rng(7);
+	std::vector<std::string> grids;
+	// one grid per line
+	std::string lines;
+	for (int i=0; i<300; i++){
+		std::string grid(81, '0');
+		Sudoku::Transformation::random(rng).apply(solution.data(), grid.data());
+		// broken grids: swapped cells, other digit or not a digit
+		if (i % 3 == 1) std::swap(grid[rng.below(81)], grid[rng.below(81)]);
+		if (i % 3 == 2) grid[rng.below(81)] = "0:.9/"[rng.below(5)];
+		grids.push_back(grid);
+		lines += grid + "\n";
+	}
+	std::vector<uint64_t> failures = Sudoku::GridValidator::validate(lines.data(), grids.size(), 82);
+	expect(failures == Sudoku::GridValidator::validate(grids), "GridValidator gives other failures for strided grids");
+	expect(failures[0] != 0, "GridValidator finds no broken grids");
+	for (size_t i=0; i<grids.size(); i++){
+		bool is_valid = grids[i].find_first_not_of("123456789") == std::string::npos &&
+			Sudoku::Puzzle(grids[i]).is_solved();
+		std::string grid = " for grid " + grids[i];
+		expect(i % 3 != 0 || is_valid, "transformed solution isn't solved" + grid);
+		expect(Sudoku::GridValidator::is_valid_scalar(grids[i].data()) == is_valid,
+			"GridValidator::is_valid_scalar disagrees with Puzzle" + grid);
+		expect(((failures[i / 64] >> (i % 64) & 1) == 0) == is_valid,
+			"GridValidator::validate disagrees with Puzzle" + grid);
+	}
+}
+
+// every set equivalence must hold in every solved puzzle
+void test_set_equivalences(int num_times){
+	for (int i=0; i<num_times; i++){
+		Sudoku::Generator generator(std::random_device{}());
+		Sudoku::Puzzle solved = Sudoku::TdokuLib(generator.generate()).solve();
+		std::string clues = solved.clues_as_string();
+		for (auto equivalence : Sudoku::Tables::set_equivalences){
+			std::map<char, int> first, second;
+			equivalence.first.for_each([&](int index){ first[clues[index]]++; });
+			equivalence.second.for_each([&](int index){ second[clues[index]]++; });
+			if (first != second){
+				std::cout << "Set equivalence \"" << equivalence.name << "\" is wrong for:\n";
+				solved.print_clues();
+				std::exit(1);
+			}
+		}
+	}
+}
+
+// shuffles bands, stacks, rows, cols and digits, transposes with chance 1/2
+std::string random_transform(std::string clues, std::mt19937 &rng){
+	auto lines_order = [&](){
+		std::array<int, 3> bands = {0, 1, 2};
+		std::shuffle(bands.begin(), bands.end(), rng);
+		std::array<int, 9> res;
+		for (int i=0; i<3; i++){
+			std::array<int, 3> lines = {0, 1, 2};
+			std::shuffle(lines.begin(), lines.end(), rng);
+			for (int j=0; j<3; j++) res[i*3 + j] = bands[i]*3 + lines[j];
+		}
+		return res;
+	};
+	std::string digits = "123456789";
+	std::shuffle(digits.begin(), digits.end(), rng);
+	std::array<int, 9> rows = lines_order(), cols = lines_order();
+	bool transposed = rng() % 2;
+
+	std::string res(81, '0');
+	for (int index=0; index<81; index++){
+		int row = rows[index / 9], col = cols[index % 9];
+		if (transposed) std::swap(row, col);
+		if (clues[index] >= '1' && clues[index] <= '9') res[row*9 + col] = digits[clues[index] - '1'];
+	}
+	return res;
+}
+
+// canonical form must be the same for every equivalent puzzle
+void test_canonical(int num_times){
+	std::mt19937 rng(std::random_device{}());
+	for (int i=0; i<num_times; i++){
+		Sudoku::Generator generator(std::random_device{}());
+		Sudoku::Puzzle puzzle = generator.generate();
+		Sudoku::Puzzle solved = Sudoku::TdokuLib(puzzle).solve();
+		for (Sudoku::Puzzle p : {puzzle, solved}){
+			std::string canonical = p.canonical();
+			std::string transformed = random_transform(p.clues_as_string(), rng);
+			if (Sudoku::Puzzle(transformed).canonical() != canonical ||
+					Sudoku::Puzzle(canonical).canonical() != canonical){
+				std::cout << "\033[31mFailed!\033[0m Canonical form differs for:\n";
+				p.print_clues();
+				std::exit(1);
+			}
+		}
+	}
+	Sudoku::Canonicalizer canonicalizer;
+	std::string result = "unchanged";
+	if (canonicalizer.minlex(std::string(80, '0'), result) || result != "unchanged"){
+		std::cout << "\033[31mFailed!\033[0m Canonical form of a short puzzle\n";
+		std::exit(1);
+	}
+}
+
+// ratings must survive reopening and be shared by equivalent puzzles
+void test_rating_cache(){
+	std::string path = "/tmp/sudoku_lib_test_rating_cache";
+	std::remove(path.c_str());
+	std::vector<std::string> puzzles = {
+		"005403670006002400000100300070046003000000000600750020001008000003200900098504100",
+		"000006509000300070018000030009030004200060007600050800040000710050003000107800000",
+	};
+	std::mt19937 rng(std::random_device{}());
+	{
+		Sudoku::RatingCache cache(path, true, 16);
+		Sudoku::RatingCache second_writer;
+		if (!cache.is_open() || second_writer.open(path, true)){
+			std::cout << "\033[31mFailed!\033[0m Rating cache must have exactly one writer\n";
+			std::exit(1);
+		}
+		for (std::string puzzle : puzzles){
+			Sudoku::HumanSolver solver{Sudoku::Puzzle(puzzle)};
+			solver.set_rating_cache(&cache);
+			solver.solve();
+		}
+	}
+	Sudoku::RatingCache cache(path, false);
+	Sudoku::RatingCache::Record record;
+	for (std::string puzzle : puzzles){
+		// equivalent puzzle is not in cache, it is rated by itself
+		std::string transformed = random_transform(puzzle, rng);
+		Sudoku::HumanSolver solver{Sudoku::Puzzle(puzzle)}, transformed_solver{Sudoku::Puzzle(transformed)};
+		solver.set_rating_cache(&cache);
+		transformed_solver.set_rating_cache(&cache);
+		if (cache.size() != puzzles.size() || solver.solve() != test_puzzle(puzzle) ||
+				transformed_solver.solve() != Sudoku::HumanSolver(Sudoku::Puzzle(transformed)).solve()){
+			std::cout << "\033[31mFailed!\033[0m Rating cache differs for:\n" << puzzle << std::endl;
+			std::exit(1);
+		}
+	}
+	if (cache.size() != puzzles.size()){
+		std::cout << "\033[31mFailed!\033[0m Read-only rating cache was changed\n";
+		std::exit(1);
+	}
+	// full table: lookup of missing key must stop
+	{
+		std::string full_path = path + "_full";
+		std::remove(full_path.c_str());
+		{
+			Sudoku::RatingCache full(full_path, true, 4);
+			for (uint64_t key = 1; key <= 3; key++){
+				full.insert(key, {});
+			}
+		}
+		std::fstream file(full_path, std::ios::in | std::ios::out | std::ios::binary);
+		// header is 24 bytes, slot is 24 bytes, key is its first field
+		for (uint64_t slot = 0; slot < 4; slot++){
+			uint64_t key = 100 + slot;
+			file.seekp(24 + slot * 24);
+			file.write(reinterpret_cast<const char *>(&key), sizeof(key));
+		}
+		file.close();
+		Sudoku::RatingCache full(full_path, false);
+		if (!full.is_open() || full.find(12345, record)){
+			std::cout << "\033[31mFailed!\033[0m Lookup in full rating cache is wrong\n";
+			std::exit(1);
+		}
+		std::remove(full_path.c_str());
+	}
+	std::remove(path.c_str());
+}
+
+// clues of every generated puzzle are symmetric and no orbit of clues can be removed
+void test_symmetric_generator(){
+	auto image = [](int cell, int map){
+		int row = cell / 9, col = cell % 9;
+		int images[6] = {(8 - row) * 9 + 8 - col, col * 9 + row, (8 - col) * 9 + 8 - row,
+			(8 - row) * 9 + col, row * 9 + 8 - col, col * 9 + 8 - row};
+		return images[map];
+	};
+	for (uint32_t symmetry : {Sudoku::rotation_180, Sudoku::diagonal, Sudoku::anti_diagonal,
+			Sudoku::horizontal, Sudoku::vertical, Sudoku::rotation_90, Sudoku::dihedral}){
+		Sudoku::Generator generator(symmetry);
+		generator.set_symmetry(symmetry);
+		std::string puzzle = generator.generate().clues_as_string();
+		bool is_symmetric = Sudoku::TdokuLib(Sudoku::Puzzle(puzzle)).has_unique_solution();
+		bool is_minimal = true;
+		for (int cell=0; cell<81; cell++){
+			for (int map=0; map<6; map++){
+				if ((symmetry & (1u << map)) && (puzzle[cell] == '0') != (puzzle[image(cell, map)] == '0')){
+					is_symmetric = false;
+				}
+			}
+			// orbit of the clue
+			if (puzzle[cell] == '0') continue;
+			std::string removed = puzzle;
+			std::vector<int> orbit = {cell};
+			for (size_t i=0; i<orbit.size(); i++){
+				removed[orbit[i]] = '0';
+				for (int map=0; map<6; map++){
+					int other = image(orbit[i], map);
+					if ((symmetry & (1u << map)) && removed[other] != '0'){
+						orbit.push_back(other);
+						removed[other] = '0';
+					}
+				}
+			}
+			is_minimal = is_minimal && !Sudoku::TdokuLib(Sudoku::Puzzle(removed)).has_unique_solution();
+		}
+		if (!is_symmetric || !is_minimal){
+			std::cout << "\033[31mFailed!\033[0m puzzle with symmetry " << symmetry << " is wrong: " << puzzle << "\n";
+			std::exit(1);
+		}
+	}
+}
+
+// puzzles from pattern have clues exactly in cells of pattern and unique solution
+void test_pattern_generator(){
+	std::vector<std::string> patterns = {
+		"xxxxxxxxx" "x.......x" "x.......x" "x..xxx..x" "x..x.x..x" "x..xxx..x" "x.......x" "x.......x" "xxxxxxxxx"};
+	for (int i=0; i<3; i++){
+		patterns.push_back(Sudoku::Generator(i).generate().clues_as_string());
+	}
+	for (size_t i=0; i<patterns.size(); i++){
+		Sudoku::Bitboard pattern;
+		for (int cell=0; cell<81; cell++){
+			if (patterns[i][cell] != '0' && patterns[i][cell] != '.') pattern.set(cell);
+		}
+		Sudoku::Generator generator(i), same_generator(i);
+		Sudoku::Puzzle puzzle, same_puzzle;
+		std::string of = " of pattern " + patterns[i];
+		expect(generator.generate_with_pattern(pattern, puzzle, 2) &&
+			same_generator.generate_with_pattern(pattern, same_puzzle, 1), "no puzzle is generated" + of);
+		expect(puzzle.clues_as_string() == same_puzzle.clues_as_string(),
+			"puzzle depends on number of threads" + of);
+		expect(Sudoku::TdokuLib(puzzle).has_unique_solution(), "puzzle has no unique solution" + of);
+		for (int cell=0; cell<81; cell++){
+			expect(pattern.test(cell) == (puzzle.clues_as_string()[cell] != '0'),
+				"clues of puzzle differ from pattern" + of);
+		}
+	}
+	// 8 clues never give unique solution
+	Sudoku::Puzzle puzzle;
+	if (Sudoku::Generator(0).generate_with_pattern(Sudoku::Bitboard(0xff, 0), puzzle, 2, 4)){
+		std::cout << "\033[31mFailed!\033[0m puzzle with 8 clues is generated\n";
+		std::exit(1);
+	}
+}
+
+// puzzle k of shard s is the same in any thread and in any order
+void test_sharded_generator(){
+	std::vector<std::string> sequential, parallel(8);
+	for (uint64_t index=0; index<8; index++){
+		sequential.push_back(Sudoku::Generator(5, index % 2, index).generate().clues_as_string());
+	}
+	std::vector<std::thread> threads;
+	for (int thread=0; thread<2; thread++){
+		threads.emplace_back([&parallel, thread](){
+			Sudoku::Generator other(thread);
+			for (int index=7 - thread; index>=0; index-=2){
+				other.generate();
+				parallel[index] = Sudoku::Generator(5, index % 2, index).generate().clues_as_string();
+			}
+		});
+	}
+	for (std::thread &thread : threads){
+		thread.join();
+	}
+	Sudoku::Utility::CounterRng rng(5), same_rng(5);
+	same_rng();
+	if (sequential != parallel || sequential[0] == sequential[2] ||
+			Sudoku::Generator(5, 0, 1).generate().clues_as_string() == sequential[1] ||
+			rng.split(1)() == rng.split(2)() || (rng(), rng()) != same_rng()){
+		std::cout << "\033[31mFailed!\033[0m sharded generator is not reproducible\n";
+		std::exit(1);
+	}
+}
+
+// amplified puzzles are different, equivalent to the source and solvable like it
+void test_amplifier(){
+	Sudoku::Puzzle source = Sudoku::Generator(3).generate();
+	Sudoku::HumanSolver::Result result = Sudoku::HumanSolver(source, true).solve();
+	Sudoku::Amplifier amplifier(source, result, 3);
+	std::vector<Sudoku::Amplifier::RatedPuzzle> puzzles = amplifier.amplify(200);
+	std::set<std::string> different = {source.clues_as_string()};
+	std::string canonical = source.canonical();
+	expect(puzzles.size() == 200, "Amplifier gives " + std::to_string(puzzles.size()) + " puzzles of 200");
+	for (size_t i=0; i<puzzles.size(); i++){
+		std::string clues = puzzles[i].puzzle.clues_as_string();
+		expect(different.insert(clues).second, "amplified puzzle repeats: " + clues);
+		expect(puzzles[i].puzzle.canonical() == canonical, "amplified puzzle isn't equivalent: " + clues);
+		if (i % 20 == 0){
+			// score of equivalent puzzle may differ (methods are searched in cell order), but it is solved
+			expect(Sudoku::HumanSolver(puzzles[i].puzzle, true).solve().is_solved == result.is_solved,
+				"amplified puzzle is solved unlike the source: " + clues);
+			expect(Sudoku::TdokuLib(puzzles[i].puzzle).has_unique_solution(),
+				"amplified puzzle has no unique solution: " + clues);
+		}
+	}
+	// empty puzzle has only one equivalent
+	Sudoku::Puzzle empty;
+	expect(!Sudoku::Amplifier(Sudoku::Puzzle(), {}).next(empty), "empty puzzle is amplified");
+}
+
+// every puzzle of the file must be read exactly once, whatever chunks are
+void test_puzzle_file(){
+	std::string path = "/tmp/sudoku_lib_test_puzzle_file";
+	std::vector<std::string> puzzles;
+	for (int i=0; i<50; i++){
+		Sudoku::Generator generator(i);
+		puzzles.push_back(generator.generate().clues_as_string());
+	}
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << "# comment\n";
+		for (size_t i=0; i<puzzles.size(); i++){
+			std::string line = puzzles[i];
+			if (i % 2 == 0) std::replace(line.begin(), line.end(), '0', '.');
+			file << line << (i % 3 == 0 ? "\r\n" : "\n");
+		}
+	}
+	Sudoku::PuzzleFile file(path);
+	for (size_t count : {1, 3, 7}){
+		std::vector<std::string> read;
+		for (Sudoku::PuzzleFile::Chunk chunk : file.chunks(count)){
+			chunk.for_each([&](std::string_view record){
+				read.push_back(Sudoku::Puzzle(record).clues_as_string());
+			});
+		}
+		if (read != puzzles){
+			std::cout << "\033[31mFailed!\033[0m Puzzle file is read wrong with " << count << " chunks\n";
+			std::exit(1);
+		}
+	}
+	std::string_view record;
+	if (!file.chunks(0).empty() || file.chunk(0, 0).next(record)){
+		std::cout << "\033[31mFailed!\033[0m Puzzle file has chunks with count 0\n";
+		std::exit(1);
+	}
+	std::remove(path.c_str());
+}
+
+// records must be read back as written, text converters must keep clues
+void test_binary_puzzle_file(){
+	std::string text_path = "/tmp/sudoku_lib_test_puzzles.txt";
+	std::string binary_path = "/tmp/sudoku_lib_test_puzzles.bin";
+	std::vector<Sudoku::BinaryPuzzleFile::Record> records;
+	{
+		Sudoku::BinaryPuzzleWriter writer(binary_path,
+			Sudoku::BinaryPuzzleFile::with_rating | Sudoku::BinaryPuzzleFile::with_solution);
+		for (int i=0; i<20; i++){
+			Sudoku::Generator generator(i);
+			Sudoku::Puzzle puzzle = generator.generate();
+			Sudoku::BinaryPuzzleFile::Record record;
+			record.clues = puzzle.clues_as_string();
+			record.clue_count = 81 - std::count(record.clues.begin(), record.clues.end(), '0');
+			record.solution = Sudoku::TdokuLib(puzzle).solve().clues_as_string();
+			record.rating = {i * 100, i % 2 == 0, uint32_t(i * 12345)};
+			writer.write(record);
+			records.push_back(record);
+		}
+	}
+	Sudoku::BinaryPuzzleReader reader(binary_path);
+	size_t read = 0;
+	for (size_t block=0; block<3; block++){
+		auto [first, last] = reader.block(block, 3);
+		for (size_t index=first; index<last; index++, read++){
+			Sudoku::BinaryPuzzleFile::Record record = reader.get(index);
+			Sudoku::BinaryPuzzleFile::Record &expected = records[index];
+			if (record.clues != expected.clues || record.solution != expected.solution ||
+					record.clue_count != expected.clue_count || record.rating.score != expected.rating.score ||
+					record.rating.is_solved != expected.rating.is_solved ||
+					record.rating.methods != expected.rating.methods){
+				std::cout << "\033[31mFailed!\033[0m Binary record " << index << " is read wrong\n";
+				std::exit(1);
+			}
+		}
+	}
+	Sudoku::binary_to_text(binary_path, text_path);
+	{
+		// lines with a wrong char or a repeated digit must be skipped
+		std::ofstream text(text_path, std::ios::app);
+		text << "x" << std::string(80, '0') << "\n11" << std::string(79, '0') << "\n";
+	}
+	size_t converted = Sudoku::text_to_binary(text_path, binary_path);
+	reader.open(binary_path);
+	if (read != records.size() || converted != records.size() ||
+			reader.size() != records.size() || reader.flags() != 0 ||
+			reader.puzzle(5).clues_as_string() != records[5].clues){
+		std::cout << "\033[31mFailed!\033[0m Binary puzzle file is converted wrong\n";
+		std::exit(1);
+	}
+	char clues[81];
+	expect(!reader.clues(reader.size(), clues) && reader.get(reader.size()).clues.empty() &&
+		reader.puzzle(reader.size()).clues_as_string() == std::string(81, '0'),
+		"binary record past the end is read");
+	expect(Sudoku::text_to_binary(text_path, "/nonexistent/puzzles.bin") == 0,
+		"text is converted to binary file, that can't be opened");
+	std::remove(text_path.c_str());
+	std::remove(binary_path.c_str());
+}
+
+// archive must keep canonical form of every puzzle, blocks are decoded in
+// threads, which also check puzzles with tdoku
+void test_puzzle_archive(){
+	std::string path = "/tmp/sudoku_lib_test_archive";
+	std::multiset<std::string> expected, decoded;
+	{
+		Sudoku::PuzzleArchiveWriter writer(path, 8);
+		for (int i=0; i<30; i++){
+			Sudoku::Generator generator(i);
+			Sudoku::Puzzle puzzle = generator.generate();
+			writer.write(puzzle.clues_as_string());
+			expected.insert(puzzle.canonical());
+		}
+	}
+	Sudoku::PuzzleArchiveReader reader(path);
+	std::mutex mutex;
+	bool are_unique = true;
+	reader.decode_parallel(3, [&](size_t, const char *puzzles, size_t count){
+		for (size_t i=0; i<count; i++){
+			std::string puzzle(puzzles + i*81, 81);
+			bool is_unique = Sudoku::TdokuLib(Sudoku::Puzzle(puzzle)).has_unique_solution();
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.insert(puzzle);
+			are_unique = are_unique && is_unique;
+		}
+	});
+	if (reader.size() != 30 || reader.block_count() != 4 || decoded != expected || !are_unique){
+		std::cout << "\033[31mFailed!\033[0m Puzzle archive is decoded wrong\n";
+		std::exit(1);
+	}
+	// prefix of the first puzzle of the first block (after 32 bytes of header)
+	// becomes 255, decoding must fail instead of writing out of the block
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(32);
+		file.put(char(0xff));
+	}
+	reader.open(path);
+	size_t blocks = 0;
+	bool is_decoded = reader.decode_parallel(2, [&](size_t, const char *, size_t){
+		std::lock_guard<std::mutex> lock(mutex);
+		blocks++;
+	});
+	if (is_decoded || blocks != 3 || !reader.decode_block(0).empty() ||
+			!reader.decode_block(4).empty() || reader.decode_block(1).size() != 8*81){
+		std::cout << "\033[31mFailed!\033[0m Corrupted puzzle archive is decoded\n";
+		std::exit(1);
+	}
+	std::remove(path.c_str());
+}
+
+// service must answer like the library does
+void test_service(){
+	std::string path = "/tmp/sudoku_lib_test_service.sock";
+	Sudoku::Service::Server::Options options;
+	options.threads = 2;
+	options.pool_size = 2;
+	Sudoku::Service::Server server(options);
+	if (!server.listen(path)){
+		std::cout << "\033[31mFailed!\033[0m Service can't listen on " << path << std::endl;
+		std::exit(1);
+	}
+	std::thread server_thread([&](){ server.run(); });
+
+	std::string puzzle = "005403670006002400000100300070046003000000000600750020001008000003200900098504100";
+	Sudoku::Service::Client client(path);
+	std::string generated, solution;
+	uint32_t solutions = 0;
+	Sudoku::RatingCache::Record rating;
+	bool is_answered = client.generate(generated) && client.solve(puzzle, solution) &&
+		client.count(generated, 2, solutions) && client.rate(puzzle, false, rating);
+	Sudoku::HumanSolver::Result expected = test_puzzle(puzzle);
+	if (!is_answered || solutions != 1 ||
+			solution != Sudoku::TdokuLib(Sudoku::Puzzle(puzzle)).solve().clues_as_string() ||
+			rating.score != expected.score ||
+			rating.methods != Sudoku::HumanSolver::methods_to_mask(expected.used_methods) ||
+			client.solve(std::string(81, '1'), solution)){
+		std::cout << "\033[31mFailed!\033[0m Service answers wrong\n";
+		std::exit(1);
+	}
+	client.close();
+	server.stop();
+	server_thread.join();
+}
+
+// runs task at once, to check that AsyncSudoku takes any executor
+class InlineExecutor : public Sudoku::Executor {
+public:
+	int tasks = 0;
+	void submit(std::function<void()> task) override {
+		tasks++;
+		task();
+	}
+};
+
+// async results must be the same as sync ones, cancelled tasks give nothing
+void test_async(){
+	std::string puzzle = "005403670006002400000100300070046003000000000600750020001008000003200900098504100";
+	Sudoku::AsyncSudoku async(2);
+	auto generated = async.generate(7);
+	auto solved = async.solve(Sudoku::Puzzle(puzzle));
+	auto rated = async.rate(Sudoku::Puzzle(puzzle));
+	Sudoku::CancellationToken token;
+	token.cancel();
+	auto cancelled = async.rate(Sudoku::Puzzle(puzzle), false, token);
+
+	InlineExecutor executor;
+	Sudoku::AsyncSudoku inline_async(executor);
+	auto is_unique = inline_async.has_unique_solution(Sudoku::Puzzle(puzzle));
+
+	auto generated_puzzle = generated.get();
+	if (!generated_puzzle ||
+			generated_puzzle->clues_as_string() != Sudoku::Generator(7).generate().clues_as_string() ||
+			solved.get()->clues_as_string() != Sudoku::TdokuLib(Sudoku::Puzzle(puzzle)).solve().clues_as_string() ||
+			rated.get().value() != test_puzzle(puzzle) || cancelled.get() ||
+			!is_unique.get().value_or(false) || executor.tasks != 1){
+		std::cout << "\033[31mFailed!\033[0m Async results differ\n";
+		std::exit(1);
+	}
+}
+
+// Puzzle is solved grid (made by pattern) without quarter of cells. Every
+// solver must find the grid.
+template <int BoxRows, int BoxCols> void test_grid_size(){
+	using Puzzle = Sudoku::BasicPuzzle<BoxRows, BoxCols>;
+	const int size = BoxRows * BoxCols;
+	Puzzle solved;
+	for (int cell=0; cell<size*size; cell++){
+		int row = cell / size, col = cell % size;
+		solved.set(cell, (row % BoxRows * BoxCols + row / BoxRows + col) % size + 1);
+	}
+	std::string clues = solved.clues_as_string();
+	std::mt19937 rng(size);
+	for (char &c : clues){
+		if (rng() % 4 == 0) c = '.';
+	}
+	Puzzle puzzle(clues), solver_solution;
+	Sudoku::BasicBacktrackingSolver<BoxRows, BoxCols> backtracking_solver;
+	Sudoku::DlxSolver<BoxRows, BoxCols> dlx_solver;
+	Sudoku::BasicHumanSolver<BoxRows, BoxCols> human_solver(puzzle);
+	bool are_solved = true;
+	std::vector<Sudoku::BasicSolver<BoxRows, BoxCols> *> solvers = {&backtracking_solver, &dlx_solver};
+	for (Sudoku::BasicSolver<BoxRows, BoxCols> *solver : solvers){
+		are_solved = are_solved && solver->has_unique_solution(puzzle) &&
+			solver->solve(puzzle, solver_solution) &&
+			solver_solution.clues_as_string() == solved.clues_as_string();
+	}
+	if (!solved.is_solved() || !are_solved ||
+			!human_solver.solve().is_solved ||
+			human_solver.get_puzzle().clues_as_string() != solved.clues_as_string()){
+		std::cout << "\033[31mFailed!\033[0m " << size << "x" << size << " puzzle is solved wrong\n";
+		std::exit(1);
+	}
+}
+
+void test_grid_sizes(){
+	test_grid_size<2, 2>();
+	test_grid_size<2, 3>();
+	test_grid_size<3, 3>();
+	test_grid_size<4, 4>();
+	test_grid_size<5, 5>();
+
+	std::string puzzle = "005403670006002400000100300070046003000000000600750020001008000003200900098504100";
+	Sudoku::BasicPuzzle<3, 3> solved, dlx_solved;
+	Sudoku::TdokuSolver tdoku;
+	Sudoku::DlxSolver<3, 3> dlx;
+	if (!tdoku.solve(Sudoku::BasicPuzzle<3, 3>(puzzle), solved) ||
+			!dlx.solve(Sudoku::BasicPuzzle<3, 3>(puzzle), dlx_solved) ||
+			solved.clues_as_string() != dlx_solved.clues_as_string() ||
+			solved.clues_as_string() != Sudoku::TdokuLib(Sudoku::Puzzle(puzzle)).solve().clues_as_string() ||
+			tdoku.count_solutions(Sudoku::BasicPuzzle<3, 3>(puzzle), 1) != 1 ||
+			tdoku.count_solutions(Sudoku::BasicPuzzle<3, 3>(), 1) != 1){
+		std::cout << "\033[31mFailed!\033[0m DLX solver differs from tdoku\n";
+		std::exit(1);
+	}
+
+	// X-sudoku: digits are also different on both diagonals
+	std::vector<std::vector<int>> houses = Sudoku::DlxSolver<3, 3>::layout_houses();
+	houses.push_back({0, 10, 20, 30, 40, 50, 60, 70, 80});
+	houses.push_back({8, 16, 24, 32, 40, 48, 56, 64, 72});
+	Sudoku::DlxSolver<3, 3> x_sudoku(houses);
+	Sudoku::BasicPuzzle<3, 3> x_solved;
+	std::set<int> main_diagonal, anti_diagonal;
+	if (x_sudoku.solve(Sudoku::BasicPuzzle<3, 3>(), x_solved)){
+		for (int i=0; i<9; i++){
+			main_diagonal.insert(x_solved.get(i * 10));
+			anti_diagonal.insert(x_solved.get(i * 8 + 8));
+		}
+	}
+	if (!x_solved.is_solved() || main_diagonal.size() != 9 || anti_diagonal.size() != 9 ||
+			x_sudoku.count_solutions(Sudoku::BasicPuzzle<3, 3>(puzzle), 2) != 0){
+		std::cout << "\033[31mFailed!\033[0m X-sudoku is solved wrong\n";
+		std::exit(1);
+	}
+}
+
+// BasicHumanSolver must solve puzzles, that need Candidate Lines and Naked
+// Pair, and report these methods
+void test_basic_human_solver(){
+	const std::vector<std::pair<std::string, std::set<std::string>>> cases = {
+		{"900003560007000080000708000309000000064080030000009102600000700000015003000000059",
+			{"Single Candidate", "Single Position", "Candidate Lines"}},
+		{"070000098902000100000007000050700003000658000000001042000006030560804000407000000",
+			{"Single Candidate", "Single Position", "Candidate Lines", "Naked Pair"}},
+	};
+	for (const auto &[clues, methods] : cases){
+		Sudoku::BasicHumanSolver<3, 3> human_solver{Sudoku::BasicPuzzle<3, 3>(clues)};
+		Sudoku::HumanSolver::Result res = human_solver.solve();
+		if (!res.is_solved || res.used_methods != methods ||
+				human_solver.get_puzzle().clues_as_string() !=
+					Sudoku::TdokuLib(Sudoku::Puzzle(clues)).solve().clues_as_string()){
+			std::cout << "\033[31mFailed!\033[0m BasicHumanSolver uses wrong methods for " << clues << "\n";
+			std::exit(1);
+		}
+	}
+}
+
+void test_variant(){
+	using Variant = Sudoku::Variant<3, 3>;
+	using Puzzle = Sudoku::BasicPuzzle<3, 3>;
+	Variant killer;
+	if (!killer.add_cage(3, {0, 1}) || !killer.add_cage(24, {2, 3, 4}) || !killer.add_cage(10, {5, 6}) ||
+			killer.get_combinations(0) != std::vector<uint16_t>{0b11} ||
+			killer.get_combinations(1) != std::vector<uint16_t>{0b111000000} ||
+			killer.get_combinations(2).size() != 4 ||
+			killer.add_cage(5, {1, 9}) || killer.get_error() != "cell 1 is already in cage" ||
+			killer.add_cage(2, {9, 10}) || killer.get_error() != "cage of 2 cells can't have sum 2" ||
+			killer.parse("cage 30 9 10") ||
+			killer.get_error() != "wrong rule \"cage 30 9 10\": cage of 2 cells can't have sum 30" ||
+			Puzzle("130000000000000000000000000000000000000000000000000000000000000000000000000000000", &killer).is_right() ||
+			Puzzle("120000000000000000000000000000000000000000000000000000000000000000000000000000000", &killer).get_candidates(2) != 0b111000000){
+		std::cout << "\033[31mFailed!\033[0m killer cages are compiled wrong\n";
+		std::exit(1);
+	}
+
+	// X-sudoku: solution of empty grid, then clues are removed while solution is unique
+	Variant x_sudoku;
+	Puzzle x_solved;
+	Sudoku::BasicBacktrackingSolver<3, 3> backtracking;
+	if (!x_sudoku.parse("diagonals") ||
+			!backtracking.solve(Puzzle(&x_sudoku), x_solved) || !x_solved.is_solved() ||
+			Puzzle("100000000000000000000000000000000000000000000000000000000000000000000000000000000", &x_sudoku).get_candidates(40) & 1){
+		std::cout << "\033[31mFailed!\033[0m X-sudoku variant is wrong\n";
+		std::exit(1);
+	}
+	Sudoku::DlxSolver<3, 3> x_dlx(x_sudoku.get_houses_without_cages());
+	Puzzle x_puzzle = x_solved;
+	std::vector<int> cells(81);
+	std::iota(cells.begin(), cells.end(), 0);
+	std::shuffle(cells.begin(), cells.end(), std::mt19937(9));
+	for (int i=0; i<45; i++){
+		x_puzzle.set(cells[i], 0);
+		if (!x_dlx.has_unique_solution(x_puzzle)){
+			x_puzzle.set(cells[i], x_solved.get(cells[i]));
+		}
+	}
+	Sudoku::BasicHumanSolver<3, 3> human_solver(x_puzzle);
+	Puzzle backtracking_solved;
+	if (!backtracking.has_unique_solution(x_puzzle) ||
+			!backtracking.solve(x_puzzle, backtracking_solved) ||
+			backtracking_solved.clues_as_string() != x_solved.clues_as_string() ||
+			!human_solver.solve().is_solved ||
+			human_solver.get_puzzle().clues_as_string() != x_solved.clues_as_string()){
+		std::cout << "\033[31mFailed!\033[0m X-sudoku is solved wrong\n";
+		std::exit(1);
+	}
+
+	// killer: cages are three cells of rows, sums are of solution of other puzzle
+	std::string solution = Sudoku::TdokuLib(Sudoku::Puzzle(
+			"005403670006002400000100300070046003000000000600750020001008000003200900098504100")).solve().clues_as_string();
+	Variant rows_killer;
+	for (int cell=0; cell<81; cell+=3){
+		rows_killer.add_cage(solution[cell] + solution[cell + 1] + solution[cell + 2] - 3 * '0', {cell, cell + 1, cell + 2});
+	}
+	Puzzle killer_puzzle(std::string(81, '0'), &rows_killer), killer_solved;
+	for (int cell=0; cell<81; cell+=2){
+		killer_puzzle.set(cell, solution[cell] - '0');
+	}
+	if (!backtracking.solve(killer_puzzle, killer_solved) || !killer_solved.is_solved() ||
+			backtracking.count_solutions(killer_puzzle, 2) != 1 ||
+			killer_solved.clues_as_string() != solution){
+		std::cout << "\033[31mFailed!\033[0m killer is solved wrong\n";
+		std::exit(1);
+	}
+
+	// jigsaw: regions are rows, so boxes may have repeated digits
+	Variant jigsaw;
+	std::string regions, latin_square;
+	for (int cell=0; cell<81; cell++){
+		regions.push_back('a' + cell / 9);
+		latin_square.push_back('1' + (cell / 9 + cell % 9) % 9);
+	}
+	if (!jigsaw.parse("regions " + regions) || !Puzzle(latin_square, &jigsaw).is_solved() ||
+			Puzzle(latin_square).is_solved() || jigsaw.parse("regions 12") ||
+			jigsaw.parse("cage 2 0 1") || jigsaw.parse("cages 3 0 1") || jigsaw.parse("house 0 x")){
+		std::cout << "\033[31mFailed!\033[0m jigsaw is solved wrong\n";
+		std::exit(1);
+	}
+}
+
 void test_generator(int num_times){
 	for (int i=0; i<num_times; i++){
 		Sudoku::Generator generator(std::random_device{}());
@@ -201,6 +1162,28 @@ int main(int argc, char **argv) {
 	if (args.has("--human-solver"), args.has("-hs")){
 		std::cout << "testing human solver" << std::endl;
 		test_human_solver();
+		test_set_equivalences(10);
+		test_step_cache();
+		test_singles_sweep();
+		test_hints();
+		test_game_state();
+		test_game_session();
+		test_grid_validator();
+		test_puzzle_parser();
+		test_canonical(10);
+		test_symmetric_generator();
+		test_pattern_generator();
+		test_sharded_generator();
+		test_amplifier();
+		test_rating_cache();
+		test_puzzle_file();
+		test_binary_puzzle_file();
+		test_puzzle_archive();
+		test_service();
+		test_async();
+		test_grid_sizes();
+		test_basic_human_solver();
+		test_variant();
 	}
 
 	if (args.has("--generator"), args.has("-g")){